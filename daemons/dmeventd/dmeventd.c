@@ -25,6 +25,7 @@
 #include "dmeventd.h"
 //#include "libmultilog.h"
 #include "dm-logging.h"
+#include "dm-ioctl.h"
 
 #include <dlfcn.h>
 #include <errno.h>
@@ -38,6 +39,8 @@
 #include <signal.h>
 #include <arpa/inet.h>		/* for htonl, ntohl */
 #include <fcntl.h>		/* for musl libc */
+#include <poll.h>
+#include <sys/ioctl.h>
 
 #ifdef linux
 /*
@@ -109,10 +112,20 @@ static pthread_mutex_t _global_mutex;
 
 #define THREAD_STACK_SIZE (300*1024)
 
+/* Released pool chunks kept by each monitor thread for plugin use */
+#define MONITOR_THREAD_POOL_CACHE 4
+
+/* Threads running process_event() for devices watched by the event loop */
+#define EVENT_LOOP_WORKERS 4
+
+/* First dm ioctl version able to poll the control device for events */
+#define DM_ARM_POLL_VERSION_MINOR 37
+
 int dmeventd_debug = 0;
 static int _systemd_activation = 0;
 static int _foreground = 0;
 static int _restart = 0;
+static int _info = 0;
 static char **_initial_registrations = 0;
 
 /* Data kept about a DSO. */
@@ -158,6 +171,16 @@ struct dso_data {
 	 */
 	int (*unregister_device)(const char *device, const char *uuid,
 				 int major, int minor, void **user);
+
+	/*
+	 * Optional timeout adjustment.
+	 *
+	 * Called after process_event() so the DSO can request the next
+	 * timeout event sooner or later than the registered timeout,
+	 * e.g. based on how fast a pool fills.  Returns milliseconds
+	 * or 0 to keep the registered interval.
+	 */
+	uint32_t (*next_timeout)(void **user);
 };
 static DM_LIST_INIT(_dso_registry);
 
@@ -199,16 +222,30 @@ struct thread_status {
 	enum dm_event_mask events;	/* bitfield for event filter. */
 	enum dm_event_mask current_events;	/* bitfield for occured events. */
 	struct dm_task *current_task;
-	time_t next_time;
+	uint64_t next_time;	/* ms on the timeout clock */
 	uint32_t timeout;
-	struct dm_list timeout_list;
+	uint32_t dso_timeout_ms;	/* Last interval asked for by the DSO */
+	unsigned timeout_index;	/* Position in timeout heap + 1, or 0 */
 	void *dso_private; /* dso per-thread status variable */
+
+	int polled;		/* Watched by the event loop, no own thread */
+	enum dm_event_mask pending_events; /* Arrived while processing */
+	struct dm_list work_list;	/* Queued for an event loop worker */
+	struct dm_list scan_list;	/* Being checked by the event loop */
+	int checking;		/* Event loop reads its info unlocked */
 };
 static DM_LIST_INIT(_thread_registry);
 static DM_LIST_INIT(_thread_registry_unused);
 
+/* Binary min-heap of devices ordered by their next timeout */
+struct timeout_heap {
+	struct thread_status **items;
+	unsigned count;
+	unsigned size;
+};
+
 static int _timeout_running;
-static DM_LIST_INIT(_timeout_registry);
+static struct timeout_heap _timeout_heap;	/* Devices with own thread */
 static pthread_mutex_t _timeout_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t _timeout_cond = PTHREAD_COND_INITIALIZER;
 
@@ -232,7 +269,7 @@ static struct thread_status *_alloc_thread_status(const struct message_data *dat
 	ret->dso_data = dso_data;
 	ret->events = data->events_field;
 	ret->timeout = data->timeout_secs;
-	dm_list_init(&ret->timeout_list);
+	dm_list_init(&ret->work_list);
 
 	return ret;
 }
@@ -442,25 +479,39 @@ static int _get_status(struct message_data *message_data)
 	int size = 0, current = 0;
 	char *buffers[count];
 	char *message;
+	uint64_t now = dmeventd_now_ms(), next;
 
 	dm_free(msg->data);
 
 	for (i = 0; i < count; ++i)
 		buffers[i] = NULL;
 
+	/*
+	 * Each record is a registration message as replayed by -R,
+	 * followed by the check interval last chosen by the DSO and the
+	 * time left until the next timeout event, both in milliseconds.
+	 * Older daemons stop parsing after the timeout.
+	 */
 	i = 0;
 	_lock_mutex();
+	pthread_mutex_lock(&_timeout_mutex);
 	dm_list_iterate_items(thread, &_thread_registry) {
-		if ((current = dm_asprintf(buffers + i, "0:%d %s %s %u %" PRIu32 ";",
+		next = (thread->timeout_index && thread->next_time > now) ?
+			thread->next_time - now : 0;
+		if ((current = dm_asprintf(buffers + i, "0:%d %s %s %u %" PRIu32
+					   " %" PRIu32 " %" PRIu64 ";",
 					   i, thread->dso_data->dso_name,
 					   thread->device.uuid, thread->events,
-					   thread->timeout)) < 0) {
+					   thread->timeout, thread->dso_timeout_ms,
+					   next)) < 0) {
+			pthread_mutex_unlock(&_timeout_mutex);
 			_unlock_mutex();
 			goto out;
 		}
 		++ i;
 		size += current;
 	}
+	pthread_mutex_unlock(&_timeout_mutex);
 	_unlock_mutex();
 
 	msg->size = size + strlen(message_data->id) + 1;
@@ -500,31 +551,170 @@ static void _exit_timeout(void *unused __attribute__((unused)))
 	pthread_mutex_unlock(&_timeout_mutex);
 }
 
+/*
+ * Timeouts are kept in milliseconds of a monotonic clock so they neither
+ * jump with the wall clock nor get rounded to whole seconds.
+ * Also used by plug-ins to time their own measurements.
+ */
+uint64_t dmeventd_now_ms(void)
+{
+#ifdef HAVE_REALTIME
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+#else
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL))
+		return 0;
+
+	return (uint64_t) tv.tv_sec * 1000 + (uint64_t) tv.tv_usec / 1000;
+#endif
+}
+
+/* Make _timeout_cond wait on the same clock as dmeventd_now_ms() */
+static void _init_timeout_cond(void)
+{
+#ifdef HAVE_REALTIME
+	pthread_condattr_t attr;
+
+	if (pthread_condattr_init(&attr))
+		return;
+
+	if (!pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) {
+		pthread_cond_destroy(&_timeout_cond);
+		pthread_cond_init(&_timeout_cond, &attr);
+	}
+
+	pthread_condattr_destroy(&attr);
+#endif
+}
+
+static void _ms_to_timespec(uint64_t ms, struct timespec *ts)
+{
+	ts->tv_sec = (time_t) (ms / 1000);
+	ts->tv_nsec = (long) (ms % 1000) * 1000000;
+}
+
+/* Next deadline after the one that just expired, without drifting */
+static void _next_timeout(struct thread_status *thread, uint64_t now)
+{
+	thread->next_time += (uint64_t) thread->timeout * 1000;
+
+	if (thread->next_time <= now)
+		thread->next_time = now + (uint64_t) thread->timeout * 1000;
+}
+
+static void _heap_set(struct timeout_heap *heap, unsigned i,
+		      struct thread_status *thread)
+{
+	heap->items[i] = thread;
+	thread->timeout_index = i + 1;
+}
+
+static void _heap_sift_up(struct timeout_heap *heap, unsigned i)
+{
+	struct thread_status *thread = heap->items[i];
+	unsigned parent;
+
+	while (i) {
+		parent = (i - 1) / 2;
+		if (heap->items[parent]->next_time <= thread->next_time)
+			break;
+		_heap_set(heap, i, heap->items[parent]);
+		i = parent;
+	}
+
+	_heap_set(heap, i, thread);
+}
+
+static void _heap_sift_down(struct timeout_heap *heap, unsigned i)
+{
+	struct thread_status *thread = heap->items[i];
+	unsigned child;
+
+	while ((child = 2 * i + 1) < heap->count) {
+		if (child + 1 < heap->count &&
+		    heap->items[child + 1]->next_time < heap->items[child]->next_time)
+			child++;
+		if (thread->next_time <= heap->items[child]->next_time)
+			break;
+		_heap_set(heap, i, heap->items[child]);
+		i = child;
+	}
+
+	_heap_set(heap, i, thread);
+}
+
+static struct thread_status *_heap_top(struct timeout_heap *heap)
+{
+	return heap->count ? heap->items[0] : NULL;
+}
+
+/* Insert thread or reposition it after its next_time changed. */
+static int _heap_update(struct timeout_heap *heap, struct thread_status *thread)
+{
+	struct thread_status **items;
+
+	if (!thread->timeout_index) {
+		if (heap->count == heap->size) {
+			if (!(items = dm_realloc(heap->items, sizeof(*items) *
+						 (heap->size ? heap->size * 2 : 64))))
+				return 0;
+			heap->items = items;
+			heap->size = heap->size ? heap->size * 2 : 64;
+		}
+		_heap_set(heap, heap->count++, thread);
+	}
+
+	_heap_sift_up(heap, thread->timeout_index - 1);
+	_heap_sift_down(heap, thread->timeout_index - 1);
+
+	return 1;
+}
+
+static void _heap_remove(struct timeout_heap *heap, struct thread_status *thread)
+{
+	unsigned i;
+
+	if (!thread->timeout_index)
+		return;
+
+	i = thread->timeout_index - 1;
+	thread->timeout_index = 0;
+
+	if (i == --heap->count)
+		return;
+
+	_heap_set(heap, i, heap->items[heap->count]);
+	_heap_sift_up(heap, i);
+	_heap_sift_down(heap, heap->items[i]->timeout_index - 1);
+}
+
 /* Wake up monitor threads every so often. */
 static void *_timeout_thread(void *unused __attribute__((unused)))
 {
 	struct thread_status *thread;
 	struct timespec timeout;
-	time_t curr_time;
+	uint64_t now;
 
-	timeout.tv_nsec = 0;
 	pthread_cleanup_push(_exit_timeout, NULL);
 	pthread_mutex_lock(&_timeout_mutex);
 
-	while (!dm_list_empty(&_timeout_registry)) {
-		timeout.tv_sec = 0;
-		curr_time = time(NULL);
+	while ((thread = _heap_top(&_timeout_heap))) {
+		now = dmeventd_now_ms();
 
-		dm_list_iterate_items_gen(thread, &_timeout_registry, timeout_list) {
-			if (thread->next_time <= curr_time) {
-				thread->next_time = curr_time + thread->timeout;
-				pthread_kill(thread->thread, SIGALRM);
-			}
-
-			if (thread->next_time < timeout.tv_sec || !timeout.tv_sec)
-				timeout.tv_sec = thread->next_time;
+		while ((thread = _heap_top(&_timeout_heap)) &&
+		       thread->next_time <= now) {
+			_next_timeout(thread, now);
+			_heap_sift_down(&_timeout_heap, 0);
+			pthread_kill(thread->thread, SIGALRM);
 		}
 
+		_ms_to_timespec(thread->next_time, &timeout);
 		pthread_cond_timedwait(&_timeout_cond, &_timeout_mutex,
 				       &timeout);
 	}
@@ -534,25 +724,40 @@ static void *_timeout_thread(void *unused __attribute__((unused)))
 	return NULL;
 }
 
+static void _event_loop_wakeup(void);
+static struct timeout_heap _event_loop_timeouts;
+
+/*
+ * Devices watched by the event loop are kept in its own heap,
+ * protected by _global_mutex which the caller must hold.
+ */
 static int _register_for_timeout(struct thread_status *thread)
 {
 	int ret = 0;
 
-	pthread_mutex_lock(&_timeout_mutex);
+	if (thread->polled) {
+		thread->next_time = dmeventd_now_ms() + (uint64_t) thread->timeout * 1000;
+		if (!_heap_update(&_event_loop_timeouts, thread))
+			return ENOMEM;
+		_event_loop_wakeup();
+		return 0;
+	}
 
-	thread->next_time = time(NULL) + thread->timeout;
+	pthread_mutex_lock(&_timeout_mutex);
 
-	if (dm_list_empty(&thread->timeout_list)) {
-		dm_list_add(&_timeout_registry, &thread->timeout_list);
-		if (_timeout_running)
-			pthread_cond_signal(&_timeout_cond);
-	}
+	thread->next_time = dmeventd_now_ms() + (uint64_t) thread->timeout * 1000;
 
-	if (!_timeout_running) {
+	if (!_heap_update(&_timeout_heap, thread))
+		ret = ENOMEM;
+	else if (_timeout_running)
+		pthread_cond_signal(&_timeout_cond);
+	else {
 		pthread_t timeout_id;
 
 		if (!(ret = _pthread_create_smallstack(&timeout_id, _timeout_thread, NULL)))
 			_timeout_running = 1;
+		else
+			_heap_remove(&_timeout_heap, thread);
 	}
 
 	pthread_mutex_unlock(&_timeout_mutex);
@@ -562,11 +767,13 @@ static int _register_for_timeout(struct thread_status *thread)
 
 static void _unregister_for_timeout(struct thread_status *thread)
 {
-	pthread_mutex_lock(&_timeout_mutex);
-	if (!dm_list_empty(&thread->timeout_list)) {
-		dm_list_del(&thread->timeout_list);
-		dm_list_init(&thread->timeout_list);
+	if (thread->polled) {
+		_heap_remove(&_event_loop_timeouts, thread);
+		return;
 	}
+
+	pthread_mutex_lock(&_timeout_mutex);
+	_heap_remove(&_timeout_heap, thread);
 	pthread_mutex_unlock(&_timeout_mutex);
 }
 
@@ -693,7 +900,36 @@ static int _do_unregister_device(struct thread_status *thread)
 /* Process an event in the DSO. */
 static void _do_process_event(struct thread_status *thread, struct dm_task *task)
 {
+	uint32_t ms;
+
 	thread->dso_data->process_event(task, thread->current_events, &(thread->dso_private));
+
+	if (!thread->dso_data->next_timeout)
+		return;
+
+	/* DSO may ask to move the next timeout event, 0 keeps it */
+	ms = thread->dso_data->next_timeout(&(thread->dso_private));
+
+	if (thread->polled) {
+		_lock_mutex();
+		thread->dso_timeout_ms = ms;
+		if (ms && thread->timeout_index) {
+			thread->next_time = dmeventd_now_ms() + ms;
+			(void) _heap_update(&_event_loop_timeouts, thread);
+		}
+		_unlock_mutex();
+		if (ms)
+			_event_loop_wakeup();
+	} else {
+		pthread_mutex_lock(&_timeout_mutex);
+		thread->dso_timeout_ms = ms;
+		if (ms && thread->timeout_index) {
+			thread->next_time = dmeventd_now_ms() + ms;
+			(void) _heap_update(&_timeout_heap, thread);
+			pthread_cond_signal(&_timeout_cond);
+		}
+		pthread_mutex_unlock(&_timeout_mutex);
+	}
 }
 
 /* Thread cleanup handler to unregister device. */
@@ -709,6 +945,9 @@ static void _monitor_unregister(void *arg)
 		thread->current_task = NULL;
 	}
 
+	/* Runs in the monitor thread itself - drop its cached pool chunks */
+	dm_pool_set_thread_cache(0);
+
 	_lock_mutex();
 	if (thread->events & DM_EVENT_TIMEOUT) {
 		/* _unregister_for_timeout locks another mutex, we
@@ -764,6 +1003,9 @@ static void *_monitor_thread(void *arg)
 	pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
 	pthread_cleanup_push(_monitor_unregister, thread);
 
+	/* Plugins create short-lived pools while processing each event */
+	dm_pool_set_thread_cache(MONITOR_THREAD_POOL_CACHE);
+
 	/* Wait for do_process_request() to finish its task. */
 	_lock_mutex();
 	thread->status = DM_THREAD_RUNNING;
@@ -846,6 +1088,275 @@ static int _terminate_thread(struct thread_status *thread)
 	return pthread_kill(thread->thread, SIGALRM);
 }
 
+/*
+ * Event loop used instead of one thread per device when the kernel can
+ * report events through poll() on the control device.  A single thread
+ * waits for any dm event or the nearest timeout, looks up which watched
+ * devices changed their event number and queues them for a small pool
+ * of workers that call the DSO's process_event().
+ */
+static int _event_loop_state;	/* 0 untried, 1 running, -1 unavailable */
+static int _event_loop_control_fd = -1;
+static int _event_loop_wake_fd[2] = { -1, -1 };
+static DM_LIST_INIT(_event_loop_queue);
+static pthread_cond_t _event_loop_cond = PTHREAD_COND_INITIALIZER;
+
+static int _arm_poll(void)
+{
+	struct dm_ioctl dmi;
+
+	memset(&dmi, 0, sizeof(dmi));
+	dmi.version[0] = DM_VERSION_MAJOR;
+	dmi.version[1] = DM_ARM_POLL_VERSION_MINOR;
+	dmi.data_size = sizeof(dmi);
+
+	return ioctl(_event_loop_control_fd, DM_DEV_ARM_POLL, &dmi) ? 0 : 1;
+}
+
+static void _event_loop_wakeup(void)
+{
+	if (_event_loop_wake_fd[1] != -1 &&
+	    write(_event_loop_wake_fd[1], "", 1) < 0 && errno != EAGAIN)
+		syslog(LOG_ERR, "Failed to wake up event loop: %s",
+		       strerror(errno));
+}
+
+/* Hand device to a worker.  Mutex must be held when calling this. */
+static void _event_loop_queue_device(struct thread_status *thread,
+				     enum dm_event_mask events)
+{
+	if (thread->processing) {
+		thread->pending_events |= events;
+		return;
+	}
+
+	thread->processing = 1;
+	thread->current_events = events;
+	dm_list_add(&_event_loop_queue, &thread->work_list);
+	pthread_cond_signal(&_event_loop_cond);
+}
+
+/*
+ * Queue device if its event number changed or detach it if it is gone.
+ * The INFO ioctl runs without the mutex so that a scan of many devices
+ * does not hold up registrations and workers.
+ */
+static void _event_loop_check_device(struct thread_status *thread)
+{
+	struct dm_task *dmt;
+	struct dm_info info;
+	int r = 0;
+
+	if ((dmt = dm_task_create(DM_DEVICE_INFO))) {
+		r = dm_task_set_uuid(dmt, thread->device.uuid) &&
+		    dm_task_run(dmt) && dm_task_get_info(dmt, &info);
+		dm_task_destroy(dmt);
+	}
+
+	_lock_mutex();
+	thread->checking = 0;
+
+	/* Skip failed queries and devices unregistered meanwhile */
+	if (!r || !thread->events || thread->status == DM_THREAD_DONE)
+		;
+	else if (!info.exists) {
+		syslog(LOG_ERR, "%s disappeared, detaching",
+		       thread->device.name);
+		thread->status = DM_THREAD_DONE;
+		_unregister_for_timeout(thread);
+		pthread_mutex_lock(&_timeout_mutex);
+		UNLINK_THREAD(thread);
+		LINK(thread, &_thread_registry_unused);
+		pthread_mutex_unlock(&_timeout_mutex);
+	} else if (info.event_nr != thread->event_nr) {
+		thread->event_nr = info.event_nr;
+		_event_loop_queue_device(thread, DM_EVENT_DEVICE_ERROR);
+	}
+	_unlock_mutex();
+}
+
+/* Check every watched device without holding the mutex over the ioctls */
+static void _event_loop_scan(void)
+{
+	struct thread_status *thread, *tmp;
+	struct dm_list scan;
+
+	dm_list_init(&scan);
+
+	_lock_mutex();
+	dm_list_iterate_items(thread, &_thread_registry)
+		if (thread->polled) {
+			/* Keeps _cleanup_unused_threads from freeing it */
+			thread->checking = 1;
+			dm_list_add(&scan, &thread->scan_list);
+		}
+	_unlock_mutex();
+
+	dm_list_iterate_items_gen_safe(thread, tmp, &scan, scan_list)
+		_event_loop_check_device(thread);
+}
+
+static void *_event_loop_thread(void *unused __attribute__((unused)))
+{
+	struct thread_status *thread;
+	struct pollfd fds[2];
+	uint64_t now;
+	int timeout_ms;
+	int scan = 1;
+	char buf[64];
+
+	fds[0].fd = _event_loop_control_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = _event_loop_wake_fd[0];
+	fds[1].events = POLLIN;
+
+	for (;;) {
+		/* Arm before scanning so no event is missed in between */
+		if (scan && !_arm_poll())
+			syslog(LOG_ERR, "Failed to arm event polling: %s",
+			       strerror(errno));
+
+		if (scan)
+			_event_loop_scan();
+
+		_lock_mutex();
+		now = dmeventd_now_ms();
+		while ((thread = _heap_top(&_event_loop_timeouts)) &&
+		       thread->next_time <= now) {
+			_next_timeout(thread, now);
+			_heap_sift_down(&_event_loop_timeouts, 0);
+			_event_loop_queue_device(thread, DM_EVENT_TIMEOUT);
+		}
+
+		timeout_ms = thread ? (int) (thread->next_time - now) : -1;
+		_unlock_mutex();
+
+		if (poll(fds, 2, timeout_ms) < 0) {
+			if (errno != EINTR)
+				syslog(LOG_ERR, "Event loop poll failed: %s",
+				       strerror(errno));
+			fds[0].revents = fds[1].revents = 0;
+		}
+
+		if (fds[1].revents & POLLIN)
+			while (read(_event_loop_wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+
+		/* Registrations changed or some device raised an event */
+		scan = (fds[0].revents | fds[1].revents) ? 1 : 0;
+	}
+
+	return NULL;
+}
+
+static void *_event_loop_worker(void *unused __attribute__((unused)))
+{
+	struct thread_status *thread;
+	struct dm_task *task;
+	enum dm_event_mask events;
+
+	/* Plugins create short-lived pools while processing each event */
+	dm_pool_set_thread_cache(MONITOR_THREAD_POOL_CACHE);
+
+	_lock_mutex();
+	for (;;) {
+		while (dm_list_empty(&_event_loop_queue))
+			pthread_cond_wait(&_event_loop_cond, &_global_mutex);
+
+		thread = dm_list_struct_base(dm_list_first(&_event_loop_queue),
+					     struct thread_status, work_list);
+		dm_list_del(&thread->work_list);
+		/* Registrations may change the mask while we process */
+		events = thread->events & thread->current_events;
+		_unlock_mutex();
+
+		if (events &&
+		    (task = _get_device_status(thread))) {
+			_do_process_event(thread, task);
+			dm_task_destroy(task);
+		}
+
+		_lock_mutex();
+		if (thread->pending_events && thread->events) {
+			thread->current_events = thread->pending_events;
+			thread->pending_events = 0;
+			dm_list_add(&_event_loop_queue, &thread->work_list);
+		} else {
+			thread->pending_events = 0;
+			thread->processing = 0;
+		}
+	}
+
+	return NULL;
+}
+
+static int _set_cloexec_nonblock(int fd)
+{
+	return (fcntl(fd, F_SETFD, FD_CLOEXEC) != -1 &&
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != -1);
+}
+
+/*
+ * Start the event loop unless the kernel lacks support for polling.
+ * Called only from the request processing thread.
+ */
+static int _event_loop_start(void)
+{
+	char control[PATH_MAX];
+	pthread_t t;
+	int workers = 0;
+
+	if (_event_loop_state)
+		return (_event_loop_state > 0);
+
+	_event_loop_state = -1;
+
+	if (dm_snprintf(control, sizeof(control), "%s/%s", dm_dir(), DM_CONTROL_NODE) < 0 ||
+	    (_event_loop_control_fd = open(control, O_RDWR)) < 0)
+		return 0;
+
+	if (!_arm_poll()) {
+		syslog(LOG_NOTICE, "Kernel cannot poll for dm events, "
+		       "using one thread per monitored device.");
+		goto bad;
+	}
+
+	if (pipe(_event_loop_wake_fd)) {
+		_event_loop_wake_fd[0] = _event_loop_wake_fd[1] = -1;
+		goto bad;
+	}
+
+	if (!_set_cloexec_nonblock(_event_loop_control_fd) ||
+	    !_set_cloexec_nonblock(_event_loop_wake_fd[0]) ||
+	    !_set_cloexec_nonblock(_event_loop_wake_fd[1]))
+		goto bad;
+
+	while (workers < EVENT_LOOP_WORKERS &&
+	       !_pthread_create_smallstack(&t, _event_loop_worker, NULL))
+		workers++;
+
+	/* Any started workers just stay idle if the loop cannot start */
+	if (!workers || _pthread_create_smallstack(&t, _event_loop_thread, NULL)) {
+		syslog(LOG_ERR, "Failed to start event loop.");
+		goto bad;
+	}
+
+	_event_loop_state = 1;
+
+	return 1;
+
+bad:
+	if (_event_loop_wake_fd[0] != -1) {
+		(void) close(_event_loop_wake_fd[0]);
+		(void) close(_event_loop_wake_fd[1]);
+		_event_loop_wake_fd[0] = _event_loop_wake_fd[1] = -1;
+	}
+	(void) close(_event_loop_control_fd);
+	_event_loop_control_fd = -1;
+
+	return 0;
+}
+
 /* DSO reference counting. Call with _global_mutex locked! */
 static void _lib_get(struct dso_data *data)
 {
@@ -887,6 +1398,9 @@ static int _lookup_symbol(void *dl, void **symbol, const char *name)
 
 static int lookup_symbols(void *dl, struct dso_data *data)
 {
+	/* Optional */
+	(void) _lookup_symbol(dl, (void *) &data->next_timeout, "next_timeout");
+
 	return _lookup_symbol(dl, (void *) &data->process_event,
 			     "process_event") &&
 	    _lookup_symbol(dl, (void *) &data->register_device,
@@ -953,6 +1467,7 @@ static int _register_for_event(struct message_data *message_data)
 	int ret = 0;
 	struct thread_status *thread, *thread_new = NULL;
 	struct dso_data *dso_data;
+	enum dm_event_mask old_events;
 
 	if (!(dso_data = _lookup_dso(message_data)) &&
 	    !(dso_data = _load_dso(message_data))) {
@@ -978,17 +1493,9 @@ static int _register_for_event(struct message_data *message_data)
 		goto out;
 	}
 
-	_lock_mutex();
+	thread_new->polled = _event_loop_start();
 
-	/* If creation of timeout thread fails (as it may), we fail
-	   here completely. The client is responsible for either
-	   retrying later or trying to register without timeout
-	   events. However, if timeout thread cannot be started, it
-	   usually means we are so starved on resources that we are
-	   almost as good as dead already... */
-	if ((thread_new->events & DM_EVENT_TIMEOUT) &&
-	    (ret = -_register_for_timeout(thread_new)))
-		goto outth;
+	_lock_mutex();
 
 	if (!(thread = _lookup_thread_status(message_data))) {
 		_unlock_mutex();
@@ -1001,7 +1508,7 @@ static int _register_for_event(struct message_data *message_data)
 
 		/* Try to create the monitoring thread for this device. */
 		_lock_mutex();
-		if ((ret = -_create_thread(thread))) {
+		if (!thread->polled && (ret = -_create_thread(thread))) {
 			_unlock_mutex();
 			_do_unregister_device(thread);
 			_free_thread_status(thread);
@@ -1009,12 +1516,31 @@ static int _register_for_event(struct message_data *message_data)
 		}
 
 		LINK_THREAD(thread);
+		if (thread->polled)
+			_event_loop_wakeup();
 	}
 
 	/* Or event # into events bitfield. */
+	old_events = thread->events;
 	thread->events |= message_data->events_field;
 
-    outth:
+	/* If creation of timeout thread fails (as it may), we fail
+	   here completely and drop the registration again. The client
+	   is responsible for either retrying later or trying to register
+	   without timeout events. However, if timeout thread cannot be
+	   started, it usually means we are so starved on resources that
+	   we are almost as good as dead already... */
+	if ((message_data->events_field & DM_EVENT_TIMEOUT) &&
+	    (ret = -_register_for_timeout(thread))) {
+		thread->events = old_events;
+		if (!thread->events) {
+			pthread_mutex_lock(&_timeout_mutex);
+			UNLINK_THREAD(thread);
+			LINK(thread, &_thread_registry_unused);
+			pthread_mutex_unlock(&_timeout_mutex);
+		}
+	}
+
 	_unlock_mutex();
 
       out:
@@ -1523,9 +2049,21 @@ static void _cleanup_unused_threads(void)
 	_lock_mutex();
 	while ((l = dm_list_first(&_thread_registry_unused))) {
 		thread = dm_list_item(l, struct thread_status);
-		if (thread->processing)
+		if (thread->processing || thread->checking)
 			break;	/* cleanup on the next round */
 
+		if (thread->polled) {
+			/* No thread to stop, event loop no longer sees it */
+			dm_list_del(l);
+			_unlock_mutex();
+			if (!_do_unregister_device(thread))
+				syslog(LOG_ERR, "%s: %s unregister failed\n",
+				       __func__, thread->device.name);
+			_lock_mutex();
+			_free_thread_status(thread);
+			continue;
+		}
+
 		if (thread->status == DM_THREAD_RUNNING) {
 			thread->status = DM_THREAD_SHUTDOWN;
 			break;
@@ -1890,13 +2428,54 @@ static void restart(void)
 	fini_fifos(&fifos);
 }
 
+/* Print the registrations of the running daemon, one per line. */
+static void info(void)
+{
+	struct dm_event_fifos fifos = { 0 };
+	struct dm_event_daemon_message msg = { 0 };
+	char *record, *next, *p;
+	int version;
+
+	if (!init_fifos(&fifos)) {
+		fprintf(stderr, "WARNING: Could not initiate communication with existing dmeventd.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!dm_event_get_version(&fifos, &version)) {
+		fprintf(stderr, "WARNING: Could not communicate with existing dmeventd.\n");
+		fini_fifos(&fifos);
+		exit(EXIT_FAILURE);
+	}
+
+	if (daemon_talk(&fifos, &msg, DM_EVENT_CMD_GET_STATUS, "-", "-", 0, 0)) {
+		fini_fifos(&fifos);
+		exit(EXIT_FAILURE);
+	}
+
+	fini_fifos(&fifos);
+
+	/* Skip the message id */
+	if (msg.data && (record = strchr(msg.data, ' ')))
+		for (++record; *record; record = next + 1) {
+			if (!(next = strchr(record, ';')))
+				break;
+			*next = 0;
+			/* Drop the "0:<n>" id of the registration */
+			if ((p = strchr(record, ' ')))
+				printf("%s\n", p + 1);
+		}
+
+	dm_free(msg.data);
+}
+
 static void usage(char *prog, FILE *file)
 {
 	fprintf(file, "Usage:\n"
-		"%s [-d [-d [-d]]] [-f] [-h] [-R] [-V] [-?]\n\n"
+		"%s [-d [-d [-d]]] [-f] [-h] [-i] [-R] [-V] [-?]\n\n"
 		"   -d       Log debug messages to syslog (-d, -dd, -ddd)\n"
 		"   -f       Don't fork, run in the foreground\n"
 		"   -h -?    Show this help information\n"
+		"   -i       Show registrations of running dmeventd\n"
 		"   -R       Restart dmeventd\n"
 		"   -V       Show version of dmeventd\n\n", prog);
 }
@@ -1911,7 +2490,7 @@ int main(int argc, char *argv[])
 	opterr = 0;
 	optind = 0;
 
-	while ((opt = getopt(argc, argv, "?fhVdR")) != EOF) {
+	while ((opt = getopt(argc, argv, "?fhVdRi")) != EOF) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0], stdout);
@@ -1919,6 +2498,9 @@ int main(int argc, char *argv[])
 		case '?':
 			usage(argv[0], stderr);
 			exit(EXIT_SUCCESS);
+		case 'i':
+			_info++;
+			break;
 		case 'R':
 			_restart++;
 			break;
@@ -1942,6 +2524,11 @@ int main(int argc, char *argv[])
 	if (setenv("LC_ALL", "C", 1))
 		perror("Cannot set LC_ALL to C");
 
+	if (_info) {
+		info();
+		exit(EXIT_SUCCESS);
+	}
+
 	if (_restart)
 		restart();
 
@@ -1984,6 +2571,7 @@ int main(int argc, char *argv[])
 		_init_fifos(&fifos);
 
 	pthread_mutex_init(&_global_mutex, NULL);
+	_init_timeout_cond();
 
 	if (!_systemd_activation && !_open_fifos(&fifos))
 		exit(EXIT_FIFO_FAILURE);
@@ -111,5 +111,10 @@ void process_event(struct dm_task *dmt, enum dm_event_mask evmask, void **user);
 int register_device(const char *device_name, const char *uuid, int major, int minor, void **user);
 int unregister_device(const char *device_name, const char *uuid, int major,
 		      int minor, void **user);
+/* Optional */
+uint32_t next_timeout(void **user);
+
+/* Provided by dmeventd to DSOs: milliseconds of its monotonic clock */
+uint64_t dmeventd_now_ms(void);
 
 #endif
@@ -16,13 +16,21 @@
 #include "log.h"
 
 #include "lvm2cmd.h"
+#include "libdevmapper-event.h"
 #include "dmeventd_lvm.h"
+#include "toolcontext.h"
+#include "config.h"
 
+#include <dirent.h>
 #include <pthread.h>
 #include <syslog.h>
 
 extern int dmeventd_debug;
 
+/* Bounds of the adaptive interval between usage checks (ms) */
+#define CHECK_INTERVAL_MIN 500
+#define CHECK_INTERVAL_MAX 30000
+
 /*
  * register_device() is called first and performs initialisation.
  * Only one device may be registered or unregistered at a time.
@@ -146,23 +154,86 @@ int dmeventd_lvm2_run(const char *cmdline)
 	return lvm2_run(_lvm_handle, cmdline);
 }
 
-int dmeventd_lvm2_command(struct dm_pool *mem, char *buffer, size_t size,
-			  const char *cmd, const char *device)
+/* Could any VG or LV be using a configuration profile? */
+static int _profiles_present(struct cmd_context *cmd)
 {
-	char *vg = NULL, *lv = NULL, *layer;
-	int r;
+	DIR *d;
+	struct dirent *dirent;
+	size_t len;
+	int r = 0;
+
+	if (!cmd->profile_params)
+		return 0;
+
+	/* Only a missing directory rules profiles out */
+	if (!(d = opendir(cmd->profile_params->dir)))
+		return (errno != ENOENT);
+
+	while (!r && (dirent = readdir(d)))
+		r = ((len = strlen(dirent->d_name)) > 8 &&
+		     !strcmp(dirent->d_name + len - 8, ".profile"));
+
+	if (closedir(d))
+		syslog(LOG_ERR, "Failed to close directory %s.\n",
+		       cmd->profile_params->dir);
+
+	return r;
+}
+
+int dmeventd_lvm2_autoextend_threshold(int thin_pool)
+{
+	struct cmd_context *cmd = _lvm_handle;
+
+	if (!cmd)
+		return 0;
 
-	if (!dm_split_lvm_name(mem, device, &vg, &lv, &layer)) {
+	/* Same reload as done before running any command */
+	if (config_files_changed(cmd) && !refresh_toolcontext(cmd))
+		return 0;
+
+	if (!thin_pool)
+		return find_config_tree_int(cmd, activation_snapshot_autoextend_threshold_CFG, NULL);
+
+	/* Thin pool policy may be overridden per VG or LV */
+	if (_profiles_present(cmd))
+		return 0;
+
+	/* lvextend refuses to run with this setting, let it report that */
+	if (!find_config_tree_int(cmd, activation_thin_pool_autoextend_percent_CFG, NULL))
+		return 0;
+
+	return find_config_tree_int(cmd, activation_thin_pool_autoextend_threshold_CFG, NULL);
+}
+
+/* Split device into VG and LV names allocated from mem */
+static int _split_lvm_name(struct dm_pool *mem, const char *device,
+			   char **vg, char **lv)
+{
+	char *layer;
+
+	if (!dm_split_lvm_name(mem, device, vg, lv, &layer)) {
 		syslog(LOG_ERR, "Unable to determine VG name from %s.\n",
 		       device);
 		return 0;
 	}
 
 	/* strip off the mirror component designations */
-	layer = strstr(lv, "_mlog");
+	layer = strstr(*lv, "_mlog");
 	if (layer)
 		*layer = '\0';
 
+	return 1;
+}
+
+int dmeventd_lvm2_command(struct dm_pool *mem, char *buffer, size_t size,
+			  const char *cmd, const char *device)
+{
+	char *vg = NULL, *lv = NULL;
+	int r;
+
+	if (!_split_lvm_name(mem, device, &vg, &lv))
+		return 0;
+
 	r = dm_snprintf(buffer, size, "%s %s/%s", cmd, vg, lv);
 
 	dm_pool_free(mem, vg);
@@ -174,3 +245,59 @@ int dmeventd_lvm2_command(struct dm_pool *mem, char *buffer, size_t size,
 
 	return 1;
 }
+
+int dmeventd_lvm2_extend(struct dm_pool *mem, const char *device)
+{
+	char *vg = NULL, *lv = NULL;
+	int r;
+
+	if (!_split_lvm_name(mem, device, &vg, &lv))
+		return 0;
+
+	r = (lvm2_extend_by_policy(_lvm_handle, vg, lv) == LVM2_COMMAND_SUCCEEDED);
+
+	dm_pool_free(mem, vg);
+
+	return r;
+}
+
+uint64_t dmeventd_lvm2_usage_update(struct dmeventd_lvm2_usage *usage,
+				    uint64_t used, uint64_t limit)
+{
+	uint64_t now = dmeventd_now_ms();
+	double current;
+
+	if (usage->last_time && now > usage->last_time) {
+		/* Released space (discards, resize) does not count */
+		current = (used > usage->last_used) ?
+			(double) (used - usage->last_used) * 1000 /
+			(double) (now - usage->last_time) : 0;
+		usage->rate = (usage->rate > 0) ?
+			(usage->rate * 3 + current) / 4 : current;
+	}
+
+	usage->last_time = now;
+	usage->last_used = used;
+
+	if (used >= limit)
+		return 0;
+
+	if (usage->rate <= 0)
+		return UINT64_MAX;
+
+	return (uint64_t) ((double) (limit - used) * 1000 / usage->rate);
+}
+
+uint32_t dmeventd_lvm2_check_interval(uint64_t ms_to_limit)
+{
+	/* Look again halfway to the limit */
+	ms_to_limit /= 2;
+
+	if (ms_to_limit < CHECK_INTERVAL_MIN)
+		return CHECK_INTERVAL_MIN;
+
+	if (ms_to_limit > CHECK_INTERVAL_MAX)
+		return CHECK_INTERVAL_MAX;
+
+	return (uint32_t) ms_to_limit;
+}
@@ -39,4 +39,40 @@ struct dm_pool *dmeventd_lvm2_pool(void);
 int dmeventd_lvm2_command(struct dm_pool *mem, char *buffer, size_t size,
 			  const char *cmd, const char *device);
 
+/*
+ * Run 'lvextend --use-policies' for device on the daemon's existing
+ * lvm2 handle without parsing a command line.
+ * Call with the lvm2 lock held.  Returns 1 on success.
+ */
+int dmeventd_lvm2_extend(struct dm_pool *mem, const char *device);
+
+/*
+ * Autoextend threshold in percent used by 'lvextend --use-policies',
+ * taken from the configuration already loaded in the daemon so the
+ * command only needs to be run once usage is above it.
+ * Returns 0 if it cannot be determined without running the command.
+ * Call with the lvm2 lock held.
+ */
+int dmeventd_lvm2_autoextend_threshold(int thin_pool);
+
+/*
+ * Fill rate tracking so plug-ins can schedule the next usage check
+ * according to how fast space is being consumed.
+ */
+struct dmeventd_lvm2_usage {
+	uint64_t last_time;	/* ms */
+	uint64_t last_used;
+	double rate;		/* Smoothed consumption per second */
+};
+
+/*
+ * Record current usage and return the projected number of ms until
+ * it reaches limit (0 if already there, UINT64_MAX if not growing).
+ */
+uint64_t dmeventd_lvm2_usage_update(struct dmeventd_lvm2_usage *usage,
+				    uint64_t used, uint64_t limit);
+
+/* Interval in ms for the next check given the projected time to limit */
+uint32_t dmeventd_lvm2_check_interval(uint64_t ms_to_limit);
+
 #endif /* _DMEVENTD_LVMWRAP_H */
@@ -31,11 +31,14 @@
 
 #define UMOUNT_COMMAND "/bin/umount"
 
+extern int dmeventd_debug;
+
 struct dso_state {
 	struct dm_pool *mem;
 	int percent_check;
 	uint64_t known_size;
-	char cmd_str[1024];
+	struct dmeventd_lvm2_usage usage;
+	uint32_t next_check;	/* ms, 0 for the registered timeout */
 };
 
 static int _run(const char *cmd, ...)
@@ -79,9 +82,9 @@ static int _run(const char *cmd, ...)
         return 1; /* all good */
 }
 
-static int _extend(const char *cmd)
+static int _extend(struct dso_state *state, const char *device)
 {
-	return dmeventd_lvm2_run(cmd) == LVM2_COMMAND_SUCCEEDED;
+	return dmeventd_lvm2_extend(state->mem, device);
 }
 
 static void _umount(const char *device, int major, int minor)
@@ -123,6 +126,17 @@ static void _umount(const char *device, int major, int minor)
 		syslog(LOG_ERR, "Failed to close /proc/mounts.\n");
 }
 
+/* 'lvextend --use-policies' does nothing below the autoextend threshold */
+static int _policy_applies(const struct dm_status_snapshot *status)
+{
+	uint64_t threshold = (uint64_t) dmeventd_lvm2_autoextend_threshold(0);
+
+	if (!threshold)
+		return 1;	/* Let the command decide */
+
+	return (status->used_sectors * 100 > threshold * status->total_sectors);
+}
+
 void process_event(struct dm_task *dmt,
 		   enum dm_event_mask event __attribute__((unused)),
 		   void **private)
@@ -133,9 +147,13 @@ void process_event(struct dm_task *dmt,
 	char *params;
 	struct dm_status_snapshot *status = NULL;
 	const char *device = dm_task_get_name(dmt);
-	int percent;
+	int percent, extend_failed = 0;
+	uint64_t limit;
+	uint32_t interval;
 	struct dso_state *state = *private;
 
+	state->next_check = 0;
+
 	/* No longer monitoring, waiting for remove */
 	if (!state->percent_check)
 		return;
@@ -183,16 +201,41 @@ void process_event(struct dm_task *dmt,
 		if (percent >= WARNING_THRESH) /* Print a warning to syslog. */
 			syslog(LOG_WARNING, "Snapshot %s is now %i%% full.\n", device, percent);
 		/* Try to extend the snapshot, in accord with user-set policies */
-		if (!_extend(state->cmd_str))
+		if (_policy_applies(status) && !_extend(state, device)) {
 			syslog(LOG_ERR, "Failed to extend snapshot %s.\n", device);
+			extend_failed = 1;
+		}
 	}
 
+	/* Check again before usage is projected to reach the next step */
+	limit = status->total_sectors *
+		(uint64_t) ((state->percent_check > 100) ? 100 : state->percent_check) / 100;
+	interval = dmeventd_lvm2_check_interval(
+		dmeventd_lvm2_usage_update(&state->usage, status->used_sectors, limit));
+
+	/* Extension failed, keep retrying at the registered interval */
+	if (extend_failed)
+		goto out;
+
+	state->next_check = interval;
+
+	if (dmeventd_debug >= 3)
+		syslog(LOG_DEBUG, "Snapshot %s uses %.1f sectors/s, next check in %"
+		       PRIu32 " ms.\n", device, state->usage.rate, interval);
 out:
 	if (status)
 		dm_pool_free(state->mem, status);
 	dmeventd_lvm2_unlock();
 }
 
+/* Time to the next timeout event requested after process_event() */
+uint32_t next_timeout(void **private)
+{
+	struct dso_state *state = *private;
+
+	return state->next_check;
+}
+
 int register_device(const char *device,
 		    const char *uuid __attribute__((unused)),
 		    int major __attribute__((unused)),
@@ -209,11 +252,6 @@ int register_device(const char *device,
 	    !(state = dm_pool_zalloc(statemem, sizeof(*state))))
 		goto bad;
 
-	if (!dmeventd_lvm2_command(statemem, state->cmd_str,
-				   sizeof(state->cmd_str),
-				   "lvextend --use-policies", device))
-		goto bad;
-
 	state->mem = statemem;
 	state->percent_check = CHECK_MINIMUM;
 	*private = state;
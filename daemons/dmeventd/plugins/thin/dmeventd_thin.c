@@ -33,13 +33,17 @@
 
 #define THIN_DEBUG 0
 
+extern int dmeventd_debug;
+
 struct dso_state {
 	struct dm_pool *mem;
 	int metadata_percent_check;
 	int data_percent_check;
 	uint64_t known_metadata_size;
 	uint64_t known_data_size;
-	char cmd_str[1024];
+	struct dmeventd_lvm2_usage metadata_usage;
+	struct dmeventd_lvm2_usage data_usage;
+	uint32_t next_check;	/* ms, 0 for the registered timeout */
 };
 
 
@@ -141,12 +145,70 @@ out:
 	return r;
 }
 
-static int _extend(struct dso_state *state)
+/* Number of used blocks at which the next check step is reached */
+static uint64_t _check_limit(uint64_t total, int percent_check)
+{
+	if (percent_check > 100)
+		percent_check = 100;
+
+	return total * (uint64_t) percent_check / 100;
+}
+
+/*
+ * Schedule the next check before either data or metadata usage is
+ * projected to reach its next step, so fast filling pools are checked
+ * early and idle ones rarely.
+ */
+static uint32_t _next_check(struct dso_state *state, const char *device,
+			    const struct dm_status_thin_pool *tps)
+{
+	uint64_t data_ms, metadata_ms;
+	uint32_t interval;
+
+	data_ms = dmeventd_lvm2_usage_update(&state->data_usage, tps->used_data_blocks,
+					     _check_limit(tps->total_data_blocks,
+							  state->data_percent_check));
+	metadata_ms = dmeventd_lvm2_usage_update(&state->metadata_usage,
+						 tps->used_metadata_blocks,
+						 _check_limit(tps->total_metadata_blocks,
+							      state->metadata_percent_check));
+
+	/* Extension failed, keep retrying at the registered interval */
+	if (!state->data_percent_check || !state->metadata_percent_check)
+		return 0;
+
+	interval = dmeventd_lvm2_check_interval((data_ms < metadata_ms) ? data_ms : metadata_ms);
+
+	if (dmeventd_debug >= 3)
+		syslog(LOG_DEBUG, "Thin %s uses %.1f data and %.1f metadata blocks/s, "
+		       "next check in %" PRIu32 " ms.\n", device, state->data_usage.rate,
+		       state->metadata_usage.rate, interval);
+
+	return interval;
+}
+
+/*
+ * A single 'lvextend --use-policies' resizes both data and metadata but
+ * does nothing until either is above the autoextend threshold, so only
+ * run the command once it can act.
+ */
+static int _policy_applies(const struct dm_status_thin_pool *tps)
+{
+	uint64_t threshold = (uint64_t) dmeventd_lvm2_autoextend_threshold(1);
+
+	if (!threshold)
+		return 1;	/* Let the command decide */
+
+	return ((tps->used_data_blocks * 100 > threshold * tps->total_data_blocks) ||
+		(tps->used_metadata_blocks * 100 > threshold * tps->total_metadata_blocks));
+}
+
+static int _extend(struct dso_state *state, const char *device)
 {
 #if THIN_DEBUG
-	syslog(LOG_INFO, "dmeventd executes: %s.\n", state->cmd_str);
+	syslog(LOG_INFO, "dmeventd extends %s by policy.\n", device);
 #endif
-	return (dmeventd_lvm2_run(state->cmd_str) == LVM2_COMMAND_SUCCEEDED);
+	return dmeventd_lvm2_extend(state->mem, device);
 }
 
 static int _run(const char *cmd, ...)
@@ -255,6 +317,7 @@ void process_event(struct dm_task *dmt,
 {
 	const char *device = dm_task_get_name(dmt);
 	int percent;
+	int extend_metadata = 0, extend_data = 0;
 	struct dso_state *state = *private;
 	struct dm_status_thin_pool *tps = NULL;
 	void *next = NULL;
@@ -267,6 +330,8 @@ void process_event(struct dm_task *dmt,
 	if (!state->meta_percent_check && !state->data_percent_check)
 		return;
 #endif
+	state->next_check = 0;
+
 	dmeventd_lvm2_lock();
 
 	dm_get_next_target(dmt, next, &start, &length, &target_type, &params);
@@ -308,17 +373,10 @@ void process_event(struct dm_task *dmt,
 		 */
 		state->metadata_percent_check = (percent / CHECK_STEP) * CHECK_STEP + CHECK_STEP;
 
-		/* FIXME: extension of metadata needs to be written! */
 		if (percent >= WARNING_THRESH) /* Print a warning to syslog. */
 			syslog(LOG_WARNING, "Thin metadata %s is now %i%% full.\n",
 			       device, percent);
-		 /* Try to extend the metadata, in accord with user-set policies */
-		if (!_extend(state)) {
-			syslog(LOG_ERR, "Failed to extend thin metadata %s.\n",
-			       device);
-			_umount(dmt, device);
-		}
-		/* FIXME: hmm READ-ONLY switch should happen in error path */
+		extend_metadata = 1;
 	}
 
 	percent = 100 * tps->used_data_blocks / tps->total_data_blocks;
@@ -331,14 +389,24 @@ void process_event(struct dm_task *dmt,
 
 		if (percent >= WARNING_THRESH) /* Print a warning to syslog. */
 			syslog(LOG_WARNING, "Thin %s is now %i%% full.\n", device, percent);
-		/* Try to extend the thin data, in accord with user-set policies */
-		if (!_extend(state)) {
+		extend_data = 1;
+	}
+
+	/* Try to extend the pool, in accord with user-set policies */
+	if ((extend_metadata || extend_data) && _policy_applies(tps) &&
+	    !_extend(state, device)) {
+		if (extend_metadata)
+			syslog(LOG_ERR, "Failed to extend thin metadata %s.\n",
+			       device);
+		if (extend_data) {
 			syslog(LOG_ERR, "Failed to extend thin %s.\n", device);
 			state->data_percent_check = 0;
-			_umount(dmt, device);
 		}
+		_umount(dmt, device);
 		/* FIXME: hmm READ-ONLY switch should happen in error path */
 	}
+
+	state->next_check = _next_check(state, device, tps);
 out:
 	if (tps)
 		dm_pool_free(state->mem, tps);
@@ -346,6 +414,14 @@ out:
 	dmeventd_lvm2_unlock();
 }
 
+/* Time to the next timeout event requested after process_event() */
+uint32_t next_timeout(void **private)
+{
+	struct dso_state *state = *private;
+
+	return state->next_check;
+}
+
 int register_device(const char *device,
 		    const char *uuid __attribute__((unused)),
 		    int major __attribute__((unused)),
@@ -359,11 +435,7 @@ int register_device(const char *device,
 		goto bad;
 
 	if (!(statemem = dm_pool_create("thin_pool_state", 2048)) ||
-	    !(state = dm_pool_zalloc(statemem, sizeof(*state))) ||
-	    !dmeventd_lvm2_command(statemem, state->cmd_str,
-				   sizeof(state->cmd_str),
-				   "lvextend --use-policies",
-				   device)) {
+	    !(state = dm_pool_zalloc(statemem, sizeof(*state)))) {
 		if (statemem)
 			dm_pool_destroy(statemem);
 		dmeventd_lvm2_exit();
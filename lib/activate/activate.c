@@ -253,6 +253,14 @@ int lv_activate_with_filter(struct cmd_context *cmd, const char *lvid_s, int exc
 {
 	return 1;
 }
+int lvs_activate_with_filter(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	return 1;
+}
+int lvs_deactivate(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	return 1;
+}
 int lv_mknodes(struct cmd_context *cmd, const struct logical_volume *lv)
 {
 	return 1;
@@ -265,6 +273,9 @@ int pv_uses_vg(struct physical_volume *pv,
 void activation_release(void)
 {
 }
+void activation_use_snapshot(int use)
+{
+}
 void activation_exit(void)
 {
 }
@@ -307,6 +318,9 @@ int monitor_dev_for_events(struct cmd_context *cmd, struct logical_volume *lv,
 void fs_unlock(void)
 {
 }
+void fs_log_udev_waits(void)
+{
+}
 /* dev_manager.c */
 #include "targets.h"
 int add_areas_line(struct dev_manager *dm, struct lv_segment *seg,
@@ -1967,6 +1981,91 @@ out:
 	return r;
 }
 
+/*
+ * Deactivate a list of LVs of one VG in a single pass, doing the
+ * same checks as lv_deactivate for each of them.
+ * Returns 0 if any of them could not be deactivated.
+ */
+int lvs_deactivate(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	struct lv_list *lvl;
+	struct logical_volume *lv, **todo;
+	struct dev_manager *dm;
+	struct lvinfo info;
+	unsigned i, count = 0;
+	int r = 1;
+
+	if (!activation() || dm_list_empty(lvs))
+		return 1;
+
+	if (!(todo = dm_pool_alloc(cmd->mem, dm_list_size(lvs) * sizeof(*todo))))
+		return_0;
+
+	dm_list_iterate_items(lvl, lvs) {
+		if (!(lv = lv_ondisk(lvl->lv))) {
+			r = 0;
+			continue;
+		}
+
+		if (test_mode()) {
+			_skip("Deactivating '%s'.", lv->name);
+			continue;
+		}
+
+		log_debug_activation("Deactivating %s/%s.", lv->vg->name, lv->name);
+
+		if (!lv_info(cmd, lv, 0, &info, 1, 0)) {
+			r = 0;
+			continue;
+		}
+
+		if (!info.exists)
+			continue;
+
+		if (lv_is_visible(lv) &&
+		    (!lv_check_not_in_use(cmd, lv, &info) ||
+		     (lv_is_origin(lv) && _lv_has_open_snapshots(lv)))) {
+			r = 0;
+			continue;
+		}
+
+		if (!lv_read_replicator_vgs(lv)) {
+			r = 0;
+			continue;
+		}
+
+		lv_calculate_readahead(lv, NULL);
+
+		if (!monitor_dev_for_events(cmd, lv, NULL, 0))
+			stack;
+
+		todo[count++] = lv;
+	}
+
+	if (!count)
+		goto out;
+
+	if (!(dm = dev_manager_create(cmd, todo[0]->vg->name, 1))) {
+		r = 0;
+		goto_out;
+	}
+
+	critical_section_inc(cmd, "deactivating");
+	if (!dev_manager_deactivate_lvs(dm, todo, count))
+		r = 0;
+	critical_section_dec(cmd, "deactivated");
+
+	dev_manager_destroy(dm);
+
+	for (i = 0; i < count; i++)
+		if (!lv_info(cmd, todo[i], 0, &info, 0, 0) || info.exists)
+			r = 0;
+out:
+	dm_pool_free(cmd->mem, todo);
+
+	return r;
+}
+
 /* Test if LV passes filter */
 int lv_activation_filter(struct cmd_context *cmd, const char *lvid_s,
 			 int *activate_lv, struct logical_volume *lv)
@@ -2097,6 +2196,88 @@ int lv_activate_with_filter(struct cmd_context *cmd, const char *lvid_s, int exc
 	return 1;
 }
 
+/*
+ * Activate a list of LVs of one VG in a single pass.
+ * Returns 0 without activating anything if any LV needs the per-LV
+ * path (e.g. it fails a check, which that path reports), so callers
+ * can fall back to activating them one at a time.
+ */
+int lvs_activate_with_filter(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	struct lv_list *lvl;
+	struct logical_volume *lv, **todo;
+	struct lv_activate_opts *laopts;
+	struct dev_manager *dm;
+	struct lvinfo info;
+	unsigned i, count = 0;
+	int r = 0;
+
+	if (!activation())
+		return 1;
+
+	if (test_mode() || dm_list_empty(lvs))
+		return 0;
+
+	if (!(todo = dm_pool_zalloc(cmd->mem, dm_list_size(lvs) *
+				    (sizeof(*todo) + sizeof(*laopts)))))
+		return_0;
+	laopts = (struct lv_activate_opts *) (todo + dm_list_size(lvs));
+
+	dm_list_iterate_items(lvl, lvs) {
+		if (!(lv = lv_ondisk(lvl->lv)))
+			goto_out;
+
+		if (!_passes_activation_filter(cmd, lv) ||
+		    (!cmd->partial_activation && (lv->status & PARTIAL_LV)) ||
+		    lv_has_unknown_segments(lv) ||
+		    lv_is_replicator_dev(lv) || (lv->status & PVMOVE)) {
+			log_debug_activation("Activating LVs in VG %s one by one for %s.",
+					     lv->vg->name, lv->name);
+			goto out;
+		}
+
+		laopts[count].exclusive = (lv_is_origin(lv) || lv_is_thin_type(lv)) ? 1 : 0;
+		laopts[count].read_only = _passes_readonly_filter(cmd, lv);
+
+		if (!lv_info(cmd, lv, 0, &info, 0, 0))
+			goto_out;
+
+		/* Nothing to do? */
+		if (info.exists && !info.suspended && info.live_table &&
+		    (info.read_only == read_only_lv(lv, &laopts[count])))
+			continue;
+
+		lv_calculate_readahead(lv, NULL);
+		todo[count++] = lv;
+	}
+
+	if (!count) {
+		r = 1;
+		goto out;
+	}
+
+	log_debug_activation("Activating %u LVs in VG %s together.",
+			     count, todo[0]->vg->name);
+
+	if (!(dm = dev_manager_create(cmd, todo[0]->vg->name, 1)))
+		goto_out;
+
+	critical_section_inc(cmd, "activating");
+	if (!(r = dev_manager_activate_lvs(dm, todo, laopts, count)))
+		stack;
+	critical_section_dec(cmd, "activated");
+
+	dev_manager_destroy(dm);
+
+	for (i = 0; r && i < count; i++)
+		if (!monitor_dev_for_events(cmd, todo[i], &laopts[i], 1))
+			stack;
+out:
+	dm_pool_free(cmd->mem, todo);
+
+	return r;
+}
+
 int lv_mknodes(struct cmd_context *cmd, const struct logical_volume *lv)
 {
 	int r = 1;
@@ -2138,6 +2319,11 @@ void activation_release(void)
 	dev_manager_release();
 }
 
+void activation_use_snapshot(int use)
+{
+	dev_manager_use_snapshot(use);
+}
+
 void activation_exit(void)
 {
 	dev_manager_exit();
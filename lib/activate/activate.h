@@ -73,6 +73,7 @@ int list_lv_modules(struct dm_pool *mem, const struct logical_volume *lv,
 		    struct dm_list *modules);
 
 void activation_release(void);
+void activation_use_snapshot(int use);
 void activation_exit(void);
 
 /* int lv_suspend(struct cmd_context *cmd, const char *lvid_s); */
@@ -83,6 +84,8 @@ int lv_resume_if_active(struct cmd_context *cmd, const char *lvid_s,
 int lv_activate(struct cmd_context *cmd, const char *lvid_s, int exclusive, struct logical_volume *lv);
 int lv_activate_with_filter(struct cmd_context *cmd, const char *lvid_s,
 			    int exclusive, struct logical_volume *lv);
+int lvs_activate_with_filter(struct cmd_context *cmd, struct dm_list *lvs);
+int lvs_deactivate(struct cmd_context *cmd, struct dm_list *lvs);
 int lv_deactivate(struct cmd_context *cmd, const char *lvid_s, struct logical_volume *lv);
 
 int lv_mknodes(struct cmd_context *cmd, const struct logical_volume *lv);
@@ -176,4 +179,7 @@ int device_is_usable(struct device *dev);
  */
 void fs_unlock(void);
 
+/* Log the number of udev waits and the time spent in them so far */
+void fs_log_udev_waits(void);
+
 #endif
@@ -25,6 +25,7 @@
 #include "config.h"
 #include "activate.h"
 #include "lvm-exec.h"
+#include "str_list.h"
 
 #include <limits.h>
 #include <dirent.h>
@@ -436,11 +437,227 @@ int device_is_usable(struct device *dev)
 	return r;
 }
 
+/*
+ * Snapshot of the kernel state of all dm devices, used by reporting
+ * commands so that every field of every LV does not cost an ioctl.
+ * Info for all devices is taken together on first use and status per
+ * VG on first status query.  Any local table change drops it.
+ */
+struct snapshot_dev {
+	struct dm_info info;
+	struct dm_task *status;		/* Set once status was taken */
+	int status_taken;
+};
+
+static int _snapshot_enabled = 0;
+static int _snapshot_failed = 0;	/* Don't retry until re-enabled */
+static struct dm_pool *_snapshot_mem = NULL;
+static struct dm_hash_table *_snapshot_devs = NULL;	/* By dm uuid */
+
+static void _snapshot_drop(void)
+{
+	struct dm_hash_node *n;
+	struct snapshot_dev *sdev;
+
+	if (!_snapshot_devs)
+		return;
+
+	dm_hash_iterate(n, _snapshot_devs) {
+		sdev = dm_hash_get_data(_snapshot_devs, n);
+		if (sdev->status)
+			dm_task_destroy(sdev->status);
+	}
+
+	dm_hash_destroy(_snapshot_devs);
+	dm_pool_destroy(_snapshot_mem);
+	_snapshot_devs = NULL;
+	_snapshot_mem = NULL;
+}
+
+void dev_manager_use_snapshot(int use)
+{
+	_snapshot_enabled = use;
+	_snapshot_failed = 0;
+
+	if (!use)
+		_snapshot_drop();
+}
+
+static void _snapshot_destroy_tasks(struct dm_task **tasks, unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		dm_task_destroy(tasks[i]);
+	dm_free(tasks);
+}
+
+/* One DM_DEVICE_LIST plus info for all devices in one batch */
+static int _snapshot_take(void)
+{
+	struct dm_task *dmt, **tasks = NULL;
+	struct dm_task_batch *batch = NULL;
+	struct dm_names *names;
+	struct snapshot_dev *sdev;
+	struct dm_info info;
+	const char *uuid;
+	unsigned next = 0, count = 0, i;
+	int r = 0;
+
+	if (!(dmt = dm_task_create(DM_DEVICE_LIST)))
+		return_0;
+
+	if (!dm_task_run(dmt) || !(names = dm_task_get_names(dmt)))
+		goto_out;
+
+	if (names->dev)
+		do {
+			names = (struct dm_names *)((char *) names + next);
+			count++;
+			next = names->next;
+		} while (next);
+
+	if (!(_snapshot_mem = dm_pool_create("dm snapshot", 16 * 1024)) ||
+	    !(_snapshot_devs = dm_hash_create(count + 16)) ||
+	    !(batch = dm_task_batch_create()) ||
+	    (count && !(tasks = dm_zalloc(sizeof(*tasks) * count)))) {
+		log_error("Failed to allocate dm state snapshot.");
+		goto out;
+	}
+
+	names = dm_task_get_names(dmt);
+	for (i = next = 0; i < count; i++) {
+		names = (struct dm_names *)((char *) names + next);
+		next = names->next;
+
+		if (!(tasks[i] = dm_task_create(DM_DEVICE_INFO)) ||
+		    !dm_task_set_name(tasks[i], names->name) ||
+		    !dm_task_batch_add(batch, tasks[i]))
+			goto_out;
+	}
+
+	/* Devices removed meanwhile just have no info */
+	if (!dm_task_batch_run(batch))
+		log_debug_activation("Some devices disappeared while taking dm snapshot.");
+
+	for (i = 0; i < count; i++) {
+		if (!dm_task_get_info(tasks[i], &info) || !info.exists ||
+		    !(uuid = dm_task_get_uuid(tasks[i])) || !*uuid)
+			continue;
+
+		if (!(sdev = dm_pool_zalloc(_snapshot_mem, sizeof(*sdev))))
+			goto_out;
+
+		sdev->info = info;
+		if (!dm_hash_insert(_snapshot_devs, uuid, sdev)) {
+			log_error("Failed to add %s to dm state snapshot.", uuid);
+			goto out;
+		}
+	}
+
+	log_debug_activation("Taken dm state snapshot of %u devices.", count);
+	r = 1;
+out:
+	if (batch)
+		dm_task_batch_destroy(batch);
+	_snapshot_destroy_tasks(tasks, tasks ? count : 0);
+	dm_task_destroy(dmt);
+
+	if (!r) {
+		_snapshot_drop();
+		_snapshot_failed = 1;
+	}
+
+	return r;
+}
+
+/*
+ * Find dlid in the snapshot, trying it also without UUID_PREFIX.
+ * Returns 0 if there is no usable snapshot, otherwise sets *sdev,
+ * which is NULL when the device does not exist.
+ */
+static int _snapshot_find(const char *dlid, struct snapshot_dev **sdev)
+{
+	if (!_snapshot_enabled || _snapshot_failed ||
+	    (!_snapshot_devs && !_snapshot_take()))
+		return 0;
+
+	if (!(*sdev = dm_hash_lookup(_snapshot_devs, dlid)))
+		*sdev = dm_hash_lookup(_snapshot_devs, dlid + sizeof(UUID_PREFIX) - 1);
+
+	return 1;
+}
+
+/* Take status of all snapshot devices of the VG of dlid together */
+static int _snapshot_take_status(const char *dlid)
+{
+	const size_t vg_prefix_len = ID_LEN + sizeof(UUID_PREFIX) - 1;
+	struct dm_hash_node *n;
+	struct dm_task_batch *batch;
+	struct snapshot_dev *sdev;
+	const char *uuid;
+	int r = 0;
+
+	if (!(batch = dm_task_batch_create()))
+		return_0;
+
+	dm_hash_iterate(n, _snapshot_devs) {
+		uuid = dm_hash_get_key(_snapshot_devs, n);
+		sdev = dm_hash_get_data(_snapshot_devs, n);
+		if (sdev->status_taken || strncmp(uuid, dlid, vg_prefix_len))
+			continue;
+
+		sdev->status_taken = 1;
+		if (!(sdev->status = dm_task_create(DM_DEVICE_STATUS)) ||
+		    !dm_task_set_uuid(sdev->status, uuid) ||
+		    !dm_task_no_open_count(sdev->status) ||
+		    !dm_task_batch_add(batch, sdev->status))
+			goto_out;
+	}
+
+	if (!dm_task_batch_run(batch))
+		log_debug_activation("Some devices disappeared while taking dm status.");
+
+	r = 1;
+out:
+	dm_task_batch_destroy(batch);
+
+	return r;
+}
+
+/* Returns status task for dlid shared with the snapshot or NULL */
+static struct dm_task *_snapshot_status(const char *dlid)
+{
+	struct snapshot_dev *sdev;
+
+	if (!_snapshot_find(dlid, &sdev) || !sdev)
+		return NULL;
+
+	if (!sdev->status_taken && !_snapshot_take_status(dlid)) {
+		_snapshot_drop();
+		return NULL;
+	}
+
+	return sdev->status;
+}
+
 static int _info(const char *dlid, int with_open_count, int with_read_ahead,
 		 struct dm_info *info, uint32_t *read_ahead)
 {
+	struct snapshot_dev *sdev;
 	int r = 0;
 
+	/* Read ahead is not part of the snapshot */
+	if (!with_read_ahead && _snapshot_find(dlid, &sdev)) {
+		if (sdev)
+			*info = sdev->info;
+		else
+			memset(info, 0, sizeof(*info));
+		if (read_ahead)
+			*read_ahead = DM_READ_AHEAD_NONE;
+		return 1;
+	}
+
 	if ((r = _info_run(NULL, dlid, info, read_ahead, 0, with_open_count,
 			   with_read_ahead, 0, 0)) && info->exists)
 		return 1;
@@ -710,21 +927,26 @@ static int _percent_run(struct dev_manager *dm, const char *name,
 	struct lv_segment *seg = NULL;
 	struct segment_type *segtype;
 	int first_time = 1;
+	int shared = 0;
 	percent_t percent = PERCENT_INVALID;
 
 	uint64_t total_numerator = 0, total_denominator = 0;
 
 	*overall_percent = percent;
 
-	if (!(dmt = _setup_task(name, dlid, event_nr,
-				wait ? DM_DEVICE_WAITEVENT : DM_DEVICE_STATUS, 0, 0)))
-		return_0;
+	if (!wait && dlid && (dmt = _snapshot_status(dlid)))
+		shared = 1;
+	else {
+		if (!(dmt = _setup_task(name, dlid, event_nr,
+					wait ? DM_DEVICE_WAITEVENT : DM_DEVICE_STATUS, 0, 0)))
+			return_0;
 
-	if (!dm_task_no_open_count(dmt))
-		log_error("Failed to disable open_count");
+		if (!dm_task_no_open_count(dmt))
+			log_error("Failed to disable open_count");
 
-	if (!dm_task_run(dmt))
-		goto_out;
+		if (!dm_task_run(dmt))
+			goto_out;
+	}
 
 	if (!dm_task_get_info(dmt, &info) || !info.exists)
 		goto_out;
@@ -794,7 +1016,8 @@ static int _percent_run(struct dev_manager *dm, const char *name,
 	r = 1;
 
       out:
-	dm_task_destroy(dmt);
+	if (!shared)
+		dm_task_destroy(dmt);
 	return r;
 }
 
@@ -934,6 +1157,7 @@ void dev_manager_destroy(struct dev_manager *dm)
 
 void dev_manager_release(void)
 {
+	_snapshot_drop();
 	dm_lib_release();
 }
 
@@ -2187,6 +2411,88 @@ static int _add_new_external_lv_to_dtree(struct dev_manager *dm,
 	return 1;
 }
 
+/* Areas of the segment are usable in a table without partial handling */
+static int _table_segment_devs_present(struct lv_segment *seg)
+{
+	uint32_t s;
+
+	for (s = 0; s < seg->area_count; s++)
+		if (seg_type(seg, s) != AREA_PV || !seg_pvseg(seg, s) ||
+		    !seg_pv(seg, s) || !seg_dev(seg, s))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Copy a segment into the dev_manager pool so it can be extended
+ * for the table without touching the metadata.
+ */
+static struct lv_segment *_copy_table_segment(struct dev_manager *dm,
+					      struct lv_segment *seg)
+{
+	struct lv_segment *copy;
+
+	if (!(copy = dm_pool_alloc(dm->mem, sizeof(*copy))))
+		return_NULL;
+
+	*copy = *seg;
+	dm_list_init(&copy->list);
+	dm_list_init(&copy->origin_list);
+	dm_list_init(&copy->thin_messages);
+
+	if (!(copy->areas = dm_pool_alloc(dm->mem, seg->area_count * sizeof(*seg->areas))))
+		return_NULL;
+	memcpy(copy->areas, seg->areas, seg->area_count * sizeof(*seg->areas));
+
+	dm_list_init(&copy->tags);
+	if (!str_list_dup(dm->mem, &copy->tags, &seg->tags))
+		return_NULL;
+
+	return copy;
+}
+
+/*
+ * Coalesce a run of adjacent striped segments continuing on the same
+ * PVs into one segment used only for the dm table, so heavily
+ * fragmented LVs load one target instead of hundreds.
+ * Metadata is left untouched.  Sets *last to the last segment covered
+ * by the returned one or NULL if nothing was merged.
+ */
+static struct lv_segment *_merge_table_segments(struct dev_manager *dm,
+						struct lv_segment *seg,
+						struct lv_segment **last)
+{
+	struct dm_list *segh = &seg->list;
+	struct lv_segment *next, *merged = NULL;
+
+	*last = NULL;
+
+	if (!seg_is_striped(seg) || (seg->lv->status & (LOCKED | PVMOVE)) ||
+	    !_table_segment_devs_present(seg))
+		return seg;
+
+	while ((segh = dm_list_next(&seg->lv->segments, segh))) {
+		next = dm_list_item(segh, struct lv_segment);
+		if (!lv_segments_compatible(merged ? : seg, next))
+			break;
+		if (!merged && !(merged = _copy_table_segment(dm, seg)))
+			return_NULL;
+		merged->len += next->len;
+		merged->area_len += next->area_len;
+		*last = next;
+	}
+
+	if (!merged)
+		return seg;
+
+	log_debug_activation("Merged segments at LE %" PRIu32 "-%" PRIu32
+			     " of %s into one target.", seg->le,
+			     (*last)->le + (*last)->len - 1, seg->lv->name);
+
+	return merged;
+}
+
 static int _add_segment_to_dtree(struct dev_manager *dm,
 				 struct dm_tree *dtree,
 				 struct dm_tree_node *dnode,
@@ -2312,7 +2618,7 @@ static int _add_new_lv_to_dtree(struct dev_manager *dm, struct dm_tree *dtree,
 				struct logical_volume *lv, struct lv_activate_opts *laopts,
 				const char *layer)
 {
-	struct lv_segment *seg;
+	struct lv_segment *seg, *table_seg, *merged_last = NULL;
 	struct lv_layer *lvlayer;
 	struct seg_list *sl;
 	struct dm_list *snh;
@@ -2428,7 +2734,15 @@ static int _add_new_lv_to_dtree(struct dev_manager *dm, struct dm_tree *dtree,
 	} else {
 		/* Add 'real' segments for LVs */
 		dm_list_iterate_items(seg, &lv->segments) {
-			if (!_add_segment_to_dtree(dm, dtree, dnode, seg, laopts, layer))
+			if (merged_last) {
+				/* Already covered by a merged table segment */
+				if (seg == merged_last)
+					merged_last = NULL;
+				continue;
+			}
+			if (!(table_seg = _merge_table_segments(dm, seg, &merged_last)))
+				return_0;
+			if (!_add_segment_to_dtree(dm, dtree, dnode, table_seg, laopts, layer))
 				return_0;
 			if (max_stripe_size < seg->stripe_size * seg->area_count)
 				max_stripe_size = seg->stripe_size * seg->area_count;
@@ -2595,6 +2909,9 @@ static int _tree_action(struct dev_manager *dm, struct logical_volume *lv,
 	char *dlid;
 	int r = 0;
 
+	/* Kernel state is going to change */
+	_snapshot_drop();
+
 	/* Some targets may build bigger tree for activation */
 	dm->activation = ((action == PRELOAD) || (action == ACTIVATE));
 	if (!(dtree = _create_partial_dtree(dm, lv, laopts->origin_only)))
@@ -2621,6 +2938,7 @@ static int _tree_action(struct dev_manager *dm, struct logical_volume *lv,
 	case DEACTIVATE:
 		if (retry_deactivation())
 			dm_tree_retry_remove(root);
+		dm_tree_set_parallel(root, parallel_workers());
 		/* Deactivate LV and all devices it references that nothing else has open. */
 		if (!dm_tree_deactivate_children(root, dlid, DLID_SIZE))
 			goto_out;
@@ -2643,6 +2961,8 @@ static int _tree_action(struct dev_manager *dm, struct logical_volume *lv,
 		if (!_add_new_lv_to_dtree(dm, dtree, lv, laopts, (lv_is_origin(lv) && laopts->origin_only) ? "real" : NULL))
 			goto_out;
 
+		dm_tree_set_parallel(root, parallel_workers());
+
 		/* Preload any devices required before any suspensions */
 		if (!dm_tree_preload_children(root, dlid, DLID_SIZE))
 			goto_out;
@@ -2688,6 +3008,102 @@ int dev_manager_activate(struct dev_manager *dm, struct logical_volume *lv,
 	return 1;
 }
 
+/*
+ * Activate several LVs of one VG through a single tree, so existing
+ * devices are scanned once and all nodes share one udev cookie.
+ */
+int dev_manager_activate_lvs(struct dev_manager *dm, struct logical_volume **lvs,
+			     struct lv_activate_opts *laopts, unsigned count)
+{
+	const size_t DLID_SIZE = ID_LEN + sizeof(UUID_PREFIX) - 1;
+	struct dm_tree *dtree;
+	struct dm_tree_node *root;
+	char *dlid;
+	unsigned i;
+	int r = 0;
+
+	if (!count)
+		return 1;
+
+	_snapshot_drop();
+	dm->activation = 1;
+	if (!(dtree = dm_tree_create())) {
+		log_debug_activation("Dtree creation failed for VG %s.", lvs[0]->vg->name);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+		if (!_add_lv_to_dtree(dm, dtree, lvs[i], 0)) {
+			stack;
+			goto out_no_root;
+		}
+
+	if (!(root = dm_tree_find_node(dtree, 0, 0))) {
+		log_error("Lost dependency tree root node");
+		goto out_no_root;
+	}
+
+	dm_tree_set_cookie(root, fs_get_cookie());
+
+	for (i = 0; i < count; i++) {
+		laopts[i].send_messages = 1;
+		if (!_add_new_lv_to_dtree(dm, dtree, lvs[i], &laopts[i], NULL))
+			goto_out;
+	}
+
+	/* All LVs share the VG part of the uuid used as the prefix */
+	if (!(dlid = build_dm_uuid(dm->mem, lvs[0]->lvid.s, NULL)))
+		goto_out;
+
+	dm_tree_set_parallel(root, parallel_workers());
+
+	if (!dm_tree_preload_children(root, dlid, DLID_SIZE))
+		goto_out;
+
+	if (!dm_tree_activate_children(root, dlid, DLID_SIZE))
+		goto_out;
+
+	if (!_create_lv_symlinks(dm, root))
+		log_warn("Failed to create symlinks for volume group %s.", lvs[0]->vg->name);
+
+	r = 1;
+out:
+	fs_set_cookie(dm_tree_get_cookie(root));
+out_no_root:
+	dm_tree_free(dtree);
+
+	if (!r)
+		return 0;
+
+	/* Deactivate any unused non-toplevel nodes, as dev_manager_activate */
+	dm->activation = 0;
+	if (!(dtree = dm_tree_create())) {
+		log_debug_activation("Dtree creation failed for VG %s.", lvs[0]->vg->name);
+		return 0;
+	}
+
+	r = 0;
+	for (i = 0; i < count; i++)
+		if (!_add_lv_to_dtree(dm, dtree, lvs[i], 0))
+			goto_bad;
+
+	if (!(root = dm_tree_find_node(dtree, 0, 0))) {
+		log_error("Lost dependency tree root node");
+		goto bad;
+	}
+
+	dm_tree_set_cookie(root, fs_get_cookie());
+	if (_clean_tree(dm, root, NULL))
+		r = 1;
+	else
+		stack;
+	fs_set_cookie(dm_tree_get_cookie(root));
+bad:
+	dm_tree_free(dtree);
+
+	return r;
+}
+
 /* origin_only may only be set if we are resuming (not activating) an origin LV */
 int dev_manager_preload(struct dev_manager *dm, struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int *flush_required)
@@ -2700,6 +3116,67 @@ int dev_manager_preload(struct dev_manager *dm, struct logical_volume *lv,
 	return 1;
 }
 
+/*
+ * Deactivate several LVs of one VG through a single tree.  Devices
+ * independent of each other are removed concurrently if configured.
+ */
+int dev_manager_deactivate_lvs(struct dev_manager *dm, struct logical_volume **lvs,
+			       unsigned count)
+{
+	const size_t DLID_SIZE = ID_LEN + sizeof(UUID_PREFIX) - 1;
+	struct dm_tree *dtree;
+	struct dm_tree_node *root;
+	char *dlid;
+	unsigned i;
+	int r = 0;
+
+	if (!count)
+		return 1;
+
+	_snapshot_drop();
+	dm->activation = 0;
+	if (!(dtree = dm_tree_create())) {
+		log_debug_activation("Dtree creation failed for VG %s.", lvs[0]->vg->name);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+		if (!_add_lv_to_dtree(dm, dtree, lvs[i], 0)) {
+			stack;
+			goto out_no_root;
+		}
+
+	if (!(root = dm_tree_find_node(dtree, 0, 0))) {
+		log_error("Lost dependency tree root node");
+		goto out_no_root;
+	}
+
+	dm_tree_set_cookie(root, fs_get_cookie());
+
+	/* All LVs share the VG part of the uuid used as the prefix */
+	if (!(dlid = build_dm_uuid(dm->mem, lvs[0]->lvid.s, NULL)))
+		goto_out;
+
+	if (retry_deactivation())
+		dm_tree_retry_remove(root);
+	dm_tree_set_parallel(root, parallel_workers());
+
+	if (!dm_tree_deactivate_children(root, dlid, DLID_SIZE))
+		goto_out;
+
+	if (!_remove_lv_symlinks(dm, root))
+		log_warn("Failed to remove all device symlinks associated with volume group %s.",
+			 lvs[0]->vg->name);
+
+	r = 1;
+out:
+	fs_set_cookie(dm_tree_get_cookie(root));
+out_no_root:
+	dm_tree_free(dtree);
+
+	return r;
+}
+
 int dev_manager_deactivate(struct dev_manager *dm, struct logical_volume *lv)
 {
 	struct lv_activate_opts laopts = { 0 };
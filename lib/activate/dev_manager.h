@@ -36,6 +36,7 @@ struct dev_manager *dev_manager_create(struct cmd_context *cmd,
 				       unsigned track_pvmove_deps);
 void dev_manager_destroy(struct dev_manager *dm);
 void dev_manager_release(void);
+void dev_manager_use_snapshot(int use);
 void dev_manager_exit(void);
 
 /*
@@ -74,9 +75,13 @@ int dev_manager_suspend(struct dev_manager *dm, struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int lockfs, int flush_required);
 int dev_manager_activate(struct dev_manager *dm, struct logical_volume *lv,
 			 struct lv_activate_opts *laopts);
+int dev_manager_activate_lvs(struct dev_manager *dm, struct logical_volume **lvs,
+			     struct lv_activate_opts *laopts, unsigned count);
 int dev_manager_preload(struct dev_manager *dm, struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int *flush_required);
 int dev_manager_deactivate(struct dev_manager *dm, struct logical_volume *lv);
+int dev_manager_deactivate_lvs(struct dev_manager *dm, struct logical_volume **lvs,
+			       unsigned count);
 int dev_manager_transient(struct dev_manager *dm, struct logical_volume *lv) __attribute__((nonnull(1, 2)));
 
 int dev_manager_mknodes(const struct logical_volume *lv);
@@ -496,6 +496,16 @@ void fs_unlock(void)
 	}
 }
 
+void fs_log_udev_waits(void)
+{
+	unsigned waits;
+	uint64_t usecs;
+
+	dm_udev_get_wait_stats(&waits, &usecs);
+	log_verbose("Waited for udev %u time(s), %" PRIu64 ".%03" PRIu64 " ms in total.",
+		    waits, usecs / 1000, usecs % 1000);
+}
+
 uint32_t fs_get_cookie(void)
 {
 	return _fs_cookie;
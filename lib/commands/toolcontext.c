@@ -296,6 +296,7 @@ static int _process_config(struct cmd_context *cmd)
 	int64_t pv_min_kb;
 	const char *lvmetad_socket;
 	int udev_disabled = 0;
+	int parallel;
 	char sysfs_dir[PATH_MAX];
 
 	if (!_check_config(cmd))
@@ -388,6 +389,12 @@ static int _process_config(struct cmd_context *cmd)
 
 	init_retry_deactivation(find_config_tree_bool(cmd, activation_retry_deactivation_CFG, NULL));
 
+	if ((parallel = find_config_tree_int(cmd, activation_parallel_workers_CFG, NULL)) < 0) {
+		log_error("Negative activation/parallel_workers not allowed.");
+		return 0;
+	}
+	init_parallel_workers((unsigned) parallel);
+
 	init_activation_checks(find_config_tree_bool(cmd, activation_checks_CFG, NULL));
 
 	cmd->use_linear_target = find_config_tree_bool(cmd, activation_use_linear_target_CFG, NULL);
@@ -1269,7 +1276,7 @@ static int _init_backup(struct cmd_context *cmd)
 
 	if (!cmd->system_dir[0]) {
 		log_warn("WARNING: Metadata changes will NOT be backed up");
-		backup_init(cmd, "", 0);
+		backup_init(cmd, "", 0, 0);
 		archive_init(cmd, "", 0, 0, 0);
 		return 1;
 	}
@@ -1313,7 +1320,8 @@ static int _init_backup(struct cmd_context *cmd)
 	if (!(dir = find_config_tree_str(cmd, backup_backup_dir_CFG, NULL)))
 		dir = default_dir;
 
-	if (!backup_init(cmd, dir, cmd->default_settings.backup)) {
+	if (!backup_init(cmd, dir, find_config_tree_bool(cmd, backup_defer_CFG, NULL),
+			 cmd->default_settings.backup)) {
 		log_debug("backup_init failed.");
 		return 0;
 	}
@@ -26,6 +26,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
 
 #ifdef linux
 #  define u64 uint64_t		/* Missing without __KERNEL__ */
@@ -749,6 +750,242 @@ int dev_write(struct device *dev, uint64_t offset, size_t len, void *buffer)
 	return ret;
 }
 
+/*-----------------------------------------------------------------
+ * Batched writes.  The workers only issue pread/pwrite and record
+ * errno; everything touching shared state (logging, allocation,
+ * device flags) stays in the calling thread.
+ *---------------------------------------------------------------*/
+#define WRITE_BATCH_MAX_THREADS 16
+#define WRITE_BATCH_STACK_SIZE (128 * 1024)
+
+struct write_job {
+	int fd;
+	struct device *dev;
+	struct device_area where;
+	struct device_area widened;
+	const char *buffer;
+	char *bounce_buf;
+	char *bounce;
+	int claimed;
+	int error;
+};
+
+struct write_batch {
+	pthread_mutex_t mutex;
+	struct write_job *jobs;
+	unsigned count;
+	unsigned next;
+};
+
+/* Returns 0 or errno; a short transfer counts as EIO. */
+static int _pio(int fd, char *buffer, uint64_t start, uint64_t size,
+		int should_write)
+{
+	size_t total = 0;
+	ssize_t n;
+
+	while (total < (size_t) size) {
+		do
+			n = should_write ?
+			    pwrite(fd, buffer + total, (size_t) size - total,
+				   (off_t) (start + total)) :
+			    pread(fd, buffer + total, (size_t) size - total,
+				  (off_t) (start + total));
+		while ((n < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+		if (n < 0)
+			return errno;
+		if (!n)
+			return EIO;
+
+		total += n;
+	}
+
+	return 0;
+}
+
+static void _run_write_job(struct write_job *job)
+{
+	if (!job->bounce) {
+		job->error = _pio(job->fd, (char *) job->buffer, job->where.start,
+				  job->where.size, 1);
+		return;
+	}
+
+	/* FIXME pre-extend the file */
+	if (_pio(job->fd, job->bounce, job->widened.start, job->widened.size, 0))
+		memset(job->bounce, '\n', job->widened.size);
+
+	memcpy(job->bounce + (job->where.start - job->widened.start),
+	       job->buffer, (size_t) job->where.size);
+
+	job->error = _pio(job->fd, job->bounce, job->widened.start,
+			  job->widened.size, 1);
+}
+
+static void *_write_batch_worker(void *arg)
+{
+	struct write_batch *batch = arg;
+	struct write_job *first;
+	unsigned i, start;
+
+	for (;;) {
+		pthread_mutex_lock(&batch->mutex);
+		while (batch->next < batch->count && batch->jobs[batch->next].claimed)
+			batch->next++;
+
+		if (batch->next == batch->count) {
+			pthread_mutex_unlock(&batch->mutex);
+			break;
+		}
+
+		/* Claim every job of this device */
+		start = batch->next;
+		first = &batch->jobs[start];
+		for (i = start; i < batch->count; i++)
+			if (batch->jobs[i].dev == first->dev)
+				batch->jobs[i].claimed = 1;
+		pthread_mutex_unlock(&batch->mutex);
+
+		for (i = start; i < batch->count; i++)
+			if (batch->jobs[i].dev == first->dev)
+				_run_write_job(&batch->jobs[i]);
+	}
+
+	return NULL;
+}
+
+static int _prepare_write_job(struct write_job *job, struct device_write *w)
+{
+	unsigned int block_size = 0;
+	uintptr_t mask;
+
+	job->dev = w->where.dev;
+	job->where = w->where;
+	job->buffer = w->buffer;
+
+	if (!job->dev->open_count)
+		return_0;
+
+	if (!_dev_is_valid(job->dev))
+		return 0;
+
+	if ((job->fd = dev_fd(job->dev)) < 0) {
+		log_error("Attempt to write an unopened device (%s).",
+			  dev_name(job->dev));
+		return 0;
+	}
+
+	if (job->where.size > SSIZE_MAX) {
+		log_error("Write size too large: %" PRIu64, job->where.size);
+		return 0;
+	}
+
+	job->dev->flags |= DEV_ACCESSED_W;
+
+	if (!(job->dev->flags & DEV_REGULAR) &&
+	    !_get_block_size(job->dev, &block_size))
+		return_0;
+
+	if (!block_size)
+		block_size = lvm_getpagesize();
+
+	_widen_region(block_size, &job->where, &job->widened);
+
+	mask = block_size - 1;
+	if (!memcmp(&job->where, &job->widened, sizeof(job->widened)) &&
+	    !((uintptr_t) job->buffer & mask))
+		return 1;
+
+	if (!(job->bounce_buf = job->bounce =
+	      dm_malloc((size_t) job->widened.size + block_size))) {
+		log_error("Bounce buffer malloc failed");
+		return 0;
+	}
+
+	if (((uintptr_t) job->bounce) & mask)
+		job->bounce = (char *) ((((uintptr_t) job->bounce) + mask) & ~mask);
+
+	return 1;
+}
+
+int dev_write_batch(struct device_write *writes, unsigned count)
+{
+	struct write_batch batch = { .count = count };
+	pthread_t threads[WRITE_BATCH_MAX_THREADS];
+	pthread_attr_t attr;
+	unsigned i, j, devices = 0, nthreads = 0;
+	int r = 0;
+
+	if (!count)
+		return 1;
+
+	if (!(batch.jobs = dm_zalloc(count * sizeof(*batch.jobs)))) {
+		log_error("Write batch allocation failed.");
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!_prepare_write_job(&batch.jobs[i], &writes[i]))
+			goto_out;
+
+		for (j = 0; j < i; j++)
+			if (batch.jobs[j].dev == batch.jobs[i].dev)
+				break;
+		if (j == i)
+			devices++;
+	}
+
+	/* Skip all writes in test mode. */
+	if (test_mode()) {
+		r = 1;
+		goto out;
+	}
+
+	pthread_mutex_init(&batch.mutex, NULL);
+
+	/* The calling thread is one of the workers. */
+	if (devices > 1 && !pthread_attr_init(&attr)) {
+		(void) pthread_attr_setstacksize(&attr, WRITE_BATCH_STACK_SIZE);
+		while (nthreads < devices - 1 &&
+		       nthreads < WRITE_BATCH_MAX_THREADS &&
+		       !pthread_create(&threads[nthreads], &attr,
+				       _write_batch_worker, &batch))
+			nthreads++;
+		pthread_attr_destroy(&attr);
+	}
+
+	log_debug_devs("Writing %u areas on %u devices with %u threads.",
+		       count, devices, nthreads + 1);
+
+	(void) _write_batch_worker(&batch);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&batch.mutex);
+
+	r = 1;
+	for (i = 0; i < count; i++) {
+		if (!batch.jobs[i].error)
+			continue;
+
+		log_error("%s: write failed at %" PRIu64 " of %" PRIu64 " bytes: %s",
+			  dev_name(batch.jobs[i].dev),
+			  (uint64_t) batch.jobs[i].where.start,
+			  (uint64_t) batch.jobs[i].where.size,
+			  strerror(batch.jobs[i].error));
+		_dev_inc_error_count(batch.jobs[i].dev);
+		r = 0;
+	}
+out:
+	for (i = 0; i < count; i++)
+		dm_free(batch.jobs[i].bounce_buf);
+	dm_free(batch.jobs);
+
+	return r;
+}
+
 int dev_set(struct device *dev, uint64_t offset, size_t len, int value)
 {
 	size_t s;
@@ -89,6 +89,16 @@ int dev_read(struct device *dev, uint64_t offset, size_t len, void *buffer);
 int dev_read_circular(struct device *dev, uint64_t offset, size_t len,
 		      uint64_t offset2, size_t len2, char *buf);
 int dev_write(struct device *dev, uint64_t offset, size_t len, void *buffer);
+
+/*
+ * Write a batch of areas on already opened devices concurrently.
+ * Areas on the same device are written in order by one thread.
+ */
+struct device_write {
+	struct device_area where;
+	const char *buffer;
+};
+int dev_write_batch(struct device_write *writes, unsigned count);
 int dev_append(struct device *dev, size_t len, char *buffer);
 int dev_set(struct device *dev, uint64_t offset, size_t len, int value);
 void dev_flush(struct device *dev);
@@ -40,8 +40,15 @@
  * the volume group name.
  *
  * Backup files that have expired will be removed.
+ *
+ * archive_vg keeps an index of each VG's archives in '.<vgname>.index'
+ * so it need not scan the directory and stat the archives every time.
+ * Each line holds index, creation time and file name, oldest first.
+ * Without a usable index, the directory is scanned and a new one written.
  */
 
+#define ARCHIVE_INDEX_MAGIC "# LVM2 archive index 1"
+
 /*
  * A list of these is built up for our volume group.  Ordered
  * with the least recent at the head.
@@ -51,6 +58,7 @@ struct archive_file {
 
 	const char *path;
 	uint32_t index;
+	time_t mtime;
 };
 
 /*
@@ -185,11 +193,152 @@ static struct dm_list *_scan_archive(struct dm_pool *mem,
 	return results;
 }
 
+static char *_archive_index_path(struct dm_pool *mem, const char *dir,
+				 const char *vgname)
+{
+	char name[NAME_LEN + 8];
+
+	if (dm_snprintf(name, sizeof(name), ".%s.index", vgname) < 0) {
+		log_error("Archive index name too long.");
+		return NULL;
+	}
+
+	return _join_file_to_dir(mem, dir, name);
+}
+
+/*
+ * Returns the list of archive_files from the index, newest first,
+ * or NULL if the index is missing or unusable.
+ */
+static struct dm_list *_read_archive_index(struct dm_pool *mem, const char *dir,
+					   const char *index_path)
+{
+	char line[PATH_MAX + 64], name[sizeof(line)];
+	struct dm_list *results;
+	struct archive_file *af;
+	int64_t mtime;
+	FILE *fp;
+	int valid = 0;
+
+	if (!(fp = fopen(index_path, "r"))) {
+		if (errno != ENOENT)
+			log_sys_debug("fopen", index_path);
+		return NULL;
+	}
+
+	if (!(results = dm_pool_alloc(mem, sizeof(*results))))
+		goto_out;
+
+	dm_list_init(results);
+
+	if (!fgets(line, sizeof(line), fp) ||
+	    strncmp(line, ARCHIVE_INDEX_MAGIC "\n", sizeof(line)))
+		goto bad;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (!(af = dm_pool_alloc(mem, sizeof(*af))))
+			goto_out;
+
+		if (sscanf(line, "%u %" PRId64 " %s", &af->index, &mtime, name) != 3 ||
+		    strchr(name, '/'))
+			goto bad;
+
+		if (!(af->path = _join_file_to_dir(mem, dir, name)))
+			goto_out;
+
+		af->mtime = (time_t) mtime;
+		dm_list_add_h(results, &af->list);
+	}
+
+	if (ferror(fp))
+		goto bad;
+
+	/* The newest archive going missing means the directory was changed */
+	if (!dm_list_empty(results)) {
+		af = dm_list_item(dm_list_first(results), struct archive_file);
+		if (!path_exists(af->path))
+			goto bad;
+	}
+
+	valid = 1;
+	goto out;
+
+bad:
+	log_debug("Ignoring archive index %s.", index_path);
+out:
+	if (fclose(fp))
+		log_sys_debug("fclose", index_path);
+
+	return valid ? results : NULL;
+}
+
+/* Atomically replace the index with the given list of archives */
+static int _write_archive_index(struct cmd_context *cmd, const char *dir,
+				const char *index_path, struct dm_list *archives)
+{
+	char temp_file[PATH_MAX];
+	struct archive_file *af;
+	const char *name;
+	FILE *fp;
+	int fd;
+
+	if (!create_temp_name(dir, temp_file, sizeof(temp_file), &fd,
+			      &cmd->rand_seed)) {
+		log_error("Couldn't create temporary archive index name.");
+		return 0;
+	}
+
+	if (!(fp = fdopen(fd, "w"))) {
+		log_error("Couldn't create FILE object for archive index.");
+		if (close(fd))
+			log_sys_error("close", temp_file);
+		goto bad;
+	}
+
+	fprintf(fp, "%s\n", ARCHIVE_INDEX_MAGIC);
+	dm_list_iterate_back_items(af, archives) {
+		name = strrchr(af->path, '/');
+		fprintf(fp, "%u %" PRId64 " %s\n", af->index, (int64_t) af->mtime,
+			name ? name + 1 : af->path);
+	}
+
+	if (lvm_fclose(fp, temp_file))
+		goto_bad;
+
+	if (rename(temp_file, index_path)) {
+		log_sys_error("rename", index_path);
+		goto bad;
+	}
+
+	return 1;
+
+bad:
+	if (unlink(temp_file))
+		log_sys_error("unlink", temp_file);
+
+	return 0;
+}
+
+/* Fill in the mtimes of a freshly scanned list of archives */
+static void _stat_archives(struct dm_list *archives)
+{
+	struct archive_file *af, *taf;
+	struct stat sb;
+
+	dm_list_iterate_items_safe(af, taf, archives) {
+		if (stat(af->path, &sb)) {
+			log_sys_error("stat", af->path);
+			dm_list_del(&af->list);
+			continue;
+		}
+		af->mtime = sb.st_mtime;
+	}
+}
+
 static void _remove_expired(struct dm_list *archives, uint32_t archives_size,
 			    uint32_t retain_days, uint32_t min_archive)
 {
 	struct archive_file *bf;
-	struct stat sb;
 	time_t retain_time;
 
 	/* Make sure there are enough archives to even bother looking for
@@ -201,36 +350,108 @@ static void _remove_expired(struct dm_list *archives, uint32_t archives_size,
 	retain_time = time(NULL) - (time_t) retain_days *SECS_PER_DAY;
 
 	/* Assume list is ordered newest first (by index) */
-	dm_list_iterate_back_items(bf, archives) {
-		/* Get the mtime of the file and unlink if too old */
-		if (stat(bf->path, &sb)) {
-			log_sys_error("stat", bf->path);
-			continue;
-		}
-
-		if (sb.st_mtime > retain_time)
+	while (!dm_list_empty(archives)) {
+		bf = dm_list_item(dm_list_last(archives), struct archive_file);
+		if (bf->mtime > retain_time)
 			return;
 
 		log_very_verbose("Expiring archive %s", bf->path);
-		if (unlink(bf->path))
+		if (unlink(bf->path) && errno != ENOENT)
 			log_sys_error("unlink", bf->path);
 
+		dm_list_del(&bf->list);
+
 		/* Don't delete any more if we've reached the minimum */
 		if (--archives_size <= min_archive)
 			return;
 	}
 }
 
+/*
+ * Give the next archive name of vg to temp_file or, without one, to a
+ * new empty file, and record it in the index.  The name is returned in
+ * archive_name.
+ */
+static int _add_archive(struct volume_group *vg, const char *dir,
+			uint32_t retain_days, uint32_t min_archive,
+			const char *temp_file, char *archive_name, size_t size)
+{
+	int i, fd, rnum, renamed = 0;
+	uint32_t ix = 0;
+	struct archive_file *last, *af;
+	char *index_path;
+	struct dm_list *archives;
+
+	if (!(index_path = _archive_index_path(vg->cmd->mem, dir, vg->name)))
+		return_0;
+
+	if (!(archives = _read_archive_index(vg->cmd->mem, dir, index_path))) {
+		if (!(archives = _scan_archive(vg->cmd->mem, vg->name, dir)))
+			return_0;
+		_stat_archives(archives);
+	}
+
+	if (dm_list_empty(archives))
+		ix = 0;
+	else {
+		last = dm_list_item(dm_list_first(archives), struct archive_file);
+		ix = last->index + 1;
+	}
+
+	rnum = rand_r(&vg->cmd->rand_seed);
+
+	for (i = 0; i < 10; i++) {
+		if (dm_snprintf(archive_name, size,
+				 "%s/%s_%05u-%d.vg",
+				 dir, vg->name, ix, rnum) < 0) {
+			log_error("Archive file name too long.");
+			return 0;
+		}
+
+		if (temp_file) {
+			if ((renamed = lvm_rename(temp_file, archive_name)))
+				break;
+		} else if ((fd = open(archive_name, O_WRONLY | O_CREAT | O_EXCL,
+				      0666)) >= 0) {
+			if (close(fd))
+				log_sys_error("close", archive_name);
+			renamed = 1;
+			break;
+		}
+
+		ix++;
+	}
+
+	if (!renamed) {
+		log_error("Archive rename failed for %s",
+			  temp_file ? : archive_name);
+		if (!temp_file)
+			return 0;
+	} else {
+		if (!(af = dm_pool_alloc(vg->cmd->mem, sizeof(*af))) ||
+		    !(af->path = dm_pool_strdup(vg->cmd->mem, archive_name)))
+			return_0;
+		af->index = ix;
+		af->mtime = time(NULL);
+		dm_list_add_h(archives, &af->list);
+	}
+
+	_remove_expired(archives, dm_list_size(archives), retain_days,
+			min_archive);
+
+	if (!_write_archive_index(vg->cmd, dir, index_path, archives))
+		log_warn("WARNING: Failed to update archive index %s.", index_path);
+
+	return 1;
+}
+
 int archive_vg(struct volume_group *vg,
 	       const char *dir, const char *desc,
 	       uint32_t retain_days, uint32_t min_archive)
 {
-	int i, fd, rnum, renamed = 0;
-	uint32_t ix = 0;
-	struct archive_file *last;
+	int fd;
 	FILE *fp = NULL;
 	char temp_file[PATH_MAX], archive_name[PATH_MAX];
-	struct dm_list *archives;
 
 	/*
 	 * Write the vg out to a temporary file.
@@ -260,39 +481,16 @@ int archive_vg(struct volume_group *vg,
 	/*
 	 * Now we want to rename this file to <vg>_index.vg.
 	 */
-	if (!(archives = _scan_archive(vg->cmd->mem, vg->name, dir)))
-		return_0;
-
-	if (dm_list_empty(archives))
-		ix = 0;
-	else {
-		last = dm_list_item(dm_list_first(archives), struct archive_file);
-		ix = last->index + 1;
-	}
-
-	rnum = rand_r(&vg->cmd->rand_seed);
-
-	for (i = 0; i < 10; i++) {
-		if (dm_snprintf(archive_name, sizeof(archive_name),
-				 "%s/%s_%05u-%d.vg",
-				 dir, vg->name, ix, rnum) < 0) {
-			log_error("Archive file name too long.");
-			return 0;
-		}
-
-		if ((renamed = lvm_rename(temp_file, archive_name)))
-			break;
-
-		ix++;
-	}
-
-	if (!renamed)
-		log_error("Archive rename failed for %s", temp_file);
-
-	_remove_expired(archives, dm_list_size(archives) + renamed, retain_days,
-			min_archive);
+	return _add_archive(vg, dir, retain_days, min_archive, temp_file,
+			    archive_name, sizeof(archive_name));
+}
 
-	return 1;
+int archive_reserve(struct volume_group *vg, const char *dir,
+		    uint32_t retain_days, uint32_t min_archive,
+		    char *archive_name, size_t size)
+{
+	return _add_archive(vg, dir, retain_days, min_archive, NULL,
+			    archive_name, size);
 }
 
 static void _display_archive(struct cmd_context *cmd, struct archive_file *af)
@@ -16,12 +16,16 @@
 #include "lib.h"
 #include "archiver.h"
 #include "format-text.h"
+#include "import-export.h"
 #include "lvm-string.h"
+#include "lvm-file.h"
 #include "lvmcache.h"
 #include "toolcontext.h"
 #include "locking.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 struct archive_params {
 	int enabled;
@@ -32,7 +36,41 @@ struct archive_params {
 
 struct backup_params {
 	int enabled;
+	int defer;
 	char *dir;
+	struct backup_writer *writer;
+};
+
+/*
+ * With backup/defer set, archives and backups are exported in memory and
+ * written by a background thread.  Each archive gets its file name and
+ * index entry up front and is always written.  A backup still queued when
+ * the VG changes again is replaced, so only the latest seqno reaches the
+ * disk.  Everything is written before the VG lock is dropped.  While a VG
+ * has a backup pending, '.<vgname>.pending' in the backup directory
+ * records that its backup file may be stale.
+ */
+struct backup_job {
+	struct dm_list list;
+	char *vgname;
+	char *path;		/* File to replace */
+	char *temp_path;
+	int archive;		/* Archives are never coalesced */
+	char *text;
+	size_t size;
+};
+
+struct backup_writer {
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+	pthread_t thread;
+	int started;		/* Thread needs joining */
+	int running;		/* Thread still takes jobs */
+	const char *writing;	/* VG name of the job being written */
+	struct dm_list jobs;
+	char *dir;
+	int error;		/* First errno seen by the thread */
+	char *error_vgname;
 };
 
 int archive_init(struct cmd_context *cmd, const char *dir,
@@ -108,6 +146,8 @@ static int __archive(struct volume_group *vg)
 			  vg->cmd->archive_params->keep_number);
 }
 
+static int _defer_archive(struct volume_group *vg);
+
 int archive(struct volume_group *vg)
 {
 	if (vg_is_archived(vg))
@@ -132,6 +172,11 @@ int archive(struct volume_group *vg)
 	     (errno == EROFS))
 		return 0;
 
+	if (vg->cmd->backup_params->defer && _defer_archive(vg)) {
+		vg->status |= ARCHIVED_VG;
+		return 1;
+	}
+
 	log_verbose("Archiving volume group \"%s\" metadata (seqno %u).", vg->name,
 		    vg->seqno);
 	if (!__archive(vg)) {
@@ -149,6 +194,9 @@ int archive_display(struct cmd_context *cmd, const char *vg_name)
 {
 	int r1, r2;
 
+	if (!backup_flush(cmd))
+		stack;
+
 	r1 = archive_list(cmd, cmd->archive_params->dir, vg_name);
 	r2 = backup_list(cmd, cmd->backup_params->dir, vg_name);
 
@@ -164,8 +212,377 @@ int archive_display_file(struct cmd_context *cmd, const char *file)
 	return r;
 }
 
+static int _backup_path(char *buf, size_t size, const char *dir,
+			const char *prefix, const char *vgname,
+			const char *suffix)
+{
+	if (dm_snprintf(buf, size, "%s/%s%s%s", dir, prefix, vgname, suffix) < 0) {
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _free_backup_job(struct backup_job *job)
+{
+	dm_free(job->vgname);
+	dm_free(job->path);
+	dm_free(job->temp_path);
+	free(job->text);	/* From open_memstream */
+	dm_free(job);
+}
+
+static struct backup_job *_find_backup_job(struct backup_writer *w,
+					   const char *vgname)
+{
+	struct backup_job *job;
+
+	dm_list_iterate_items(job, &w->jobs)
+		if (!job->archive && !strcmp(job->vgname, vgname))
+			return job;
+
+	return NULL;
+}
+
+/* Runs in the writer thread so must not log.  Returns errno or 0. */
+static int _write_backup_job(struct backup_job *job)
+{
+	char dir[PATH_MAX], *slash;
+	const char *p = job->text;
+	size_t left = job->size;
+	ssize_t n;
+	int fd, r = 0;
+
+	if ((fd = open(job->temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+		return errno;
+
+	while (left) {
+		if ((n = write(fd, p, left)) < 0) {
+			if (errno == EINTR)
+				continue;
+			r = errno;
+			break;
+		}
+		p += n;
+		left -= (size_t) n;
+	}
+
+	if (!r && fsync(fd) && (errno != EROFS) && (errno != EINVAL))
+		r = errno;
+
+	if (close(fd) && !r)
+		r = errno;
+
+	if (!r && rename(job->temp_path, job->path))
+		r = errno;
+
+	if (r) {
+		(void) unlink(job->temp_path);
+		/* Drop the empty file reserved for the archive */
+		if (job->archive)
+			(void) unlink(job->path);
+	} else {
+		strncpy(dir, job->path, sizeof(dir) - 1);
+		dir[sizeof(dir) - 1] = '\0';
+		if ((slash = strrchr(dir, '/')))
+			*slash = '\0';
+		if ((fd = open(slash ? dir : ".", O_RDONLY)) >= 0) {
+			(void) fsync(fd);
+			(void) close(fd);
+		}
+	}
+
+	return r;
+}
+
+static void *_backup_writer_thread(void *arg)
+{
+	struct backup_writer *w = arg;
+	struct backup_job *job;
+	char marker[PATH_MAX];
+	int r;
+
+	pthread_mutex_lock(&w->lock);
+	while (!dm_list_empty(&w->jobs)) {
+		job = dm_list_item(dm_list_first(&w->jobs), struct backup_job);
+		dm_list_del(&job->list);
+		if (!job->archive)
+			w->writing = job->vgname;
+		pthread_mutex_unlock(&w->lock);
+
+		r = _write_backup_job(job);
+
+		pthread_mutex_lock(&w->lock);
+		w->writing = NULL;
+		if (r && !w->error) {
+			w->error = r;
+			w->error_vgname = job->vgname;
+			job->vgname = NULL;
+		} else if (!r && !job->archive && !_find_backup_job(w, job->vgname) &&
+			   _backup_path(marker, sizeof(marker), w->dir, ".",
+					job->vgname, ".pending"))
+			(void) unlink(marker);
+		_free_backup_job(job);
+	}
+	w->running = 0;
+	pthread_cond_broadcast(&w->idle);
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/* Wait for all deferred backups to reach the disk */
+int backup_flush(struct cmd_context *cmd)
+{
+	struct backup_writer *w;
+	int r = 1;
+
+	if (!cmd->backup_params || !(w = cmd->backup_params->writer) || !w->started)
+		return 1;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->running)
+		pthread_cond_wait(&w->idle, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+
+	if (pthread_join(w->thread, NULL))
+		log_error("Failed to wait for backup writer thread.");
+	w->started = 0;
+
+	if (w->error) {
+		errno = w->error;
+		log_error("Deferred archive or backup of volume group %s metadata failed: %s",
+			  w->error_vgname ? : "", strerror(w->error));
+		dm_free(w->error_vgname);
+		w->error_vgname = NULL;
+		w->error = 0;
+		r = 0;
+	}
+
+	return r;
+}
+
+static void _destroy_backup_writer(struct cmd_context *cmd)
+{
+	struct backup_writer *w = cmd->backup_params->writer;
+
+	if (!w)
+		return;
+
+	if (!backup_flush(cmd))
+		stack;
+
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->idle);
+	dm_free(w->dir);
+	dm_free(w);
+	cmd->backup_params->writer = NULL;
+}
+
+static struct backup_writer *_get_backup_writer(struct cmd_context *cmd)
+{
+	struct backup_writer *w;
+
+	if ((w = cmd->backup_params->writer))
+		return w;
+
+	if (!(w = dm_zalloc(sizeof(*w))) ||
+	    !(w->dir = dm_strdup(cmd->backup_params->dir))) {
+		log_error("Failed to allocate backup writer.");
+		if (w) {
+			dm_free(w->dir);
+			dm_free(w);
+		}
+		return NULL;
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->idle, NULL);
+	dm_list_init(&w->jobs);
+
+	return cmd->backup_params->writer = w;
+}
+
+/* Note that the backup file may be stale until the queued backup lands */
+static int _create_backup_marker(const char *dir, const char *vgname,
+				 uint32_t seqno)
+{
+	char marker[PATH_MAX], buf[32];
+	int fd, r = 1;
+
+	if (!_backup_path(marker, sizeof(marker), dir, ".", vgname, ".pending")) {
+		log_error("Backup marker name too long.");
+		return 0;
+	}
+
+	if ((fd = open(marker, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		log_sys_error("open", marker);
+		return 0;
+	}
+
+	(void) dm_snprintf(buf, sizeof(buf), "%u\n", seqno);
+	if ((write(fd, buf, strlen(buf)) < 0) || fsync(fd)) {
+		log_sys_error("write", marker);
+		r = 0;
+	}
+
+	if (close(fd)) {
+		log_sys_error("close", marker);
+		r = 0;
+	}
+
+	return r;
+}
+
+/*
+ * Hand the text of vg to the writer thread to replace its backup or,
+ * with archive_name, to fill in that reserved archive.  Returns 0 if
+ * the caller needs to write it now.
+ */
+static int _defer_write(struct volume_group *vg, const char *desc,
+			const char *archive_name)
+{
+	struct backup_writer *w;
+	struct backup_job *job, *queued;
+	char path[PATH_MAX], temp_path[PATH_MAX];
+	const char *dir, *name;
+	FILE *fp;
+	int r = 0;
+
+	if (!(w = _get_backup_writer(vg->cmd)))
+		return_0;
+
+	if (archive_name) {
+		dir = vg->cmd->archive_params->dir;
+		name = (name = strrchr(archive_name, '/')) ? name + 1 : archive_name;
+	} else {
+		dir = w->dir;
+		name = vg->name;
+	}
+
+	if (!_backup_path(path, sizeof(path), dir, "", name, "") ||
+	    !_backup_path(temp_path, sizeof(temp_path), dir, ".", name, ".tmp")) {
+		log_error("Deferred %s file name too long.",
+			  archive_name ? "archive" : "backup");
+		return 0;
+	}
+
+	if (!(job = dm_zalloc(sizeof(*job))) ||
+	    !(job->vgname = dm_strdup(vg->name)) ||
+	    !(job->path = dm_strdup(path)) ||
+	    !(job->temp_path = dm_strdup(temp_path))) {
+		log_error("Failed to allocate deferred %s.",
+			  archive_name ? "archive" : "backup");
+		goto bad;
+	}
+
+	job->archive = archive_name ? 1 : 0;
+
+	if (!(fp = open_memstream(&job->text, &job->size))) {
+		log_sys_error("open_memstream", vg->name);
+		goto bad;
+	}
+
+	if (!text_vg_export_file(vg, desc, fp)) {
+		(void) fclose(fp);
+		goto_bad;
+	}
+
+	if (fclose(fp)) {
+		log_sys_error("fclose", vg->name);
+		goto bad;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	if (job->archive) {
+		dm_list_add(&w->jobs, &job->list);
+		job = NULL;
+	} else if ((queued = _find_backup_job(w, vg->name))) {
+		/* Coalesce with the older backup still waiting */
+		dm_list_add_h(&queued->list, &job->list);
+		dm_list_del(&queued->list);
+		_free_backup_job(queued);
+		job = NULL;
+	} else if ((w->writing && !strcmp(w->writing, vg->name)) ||
+		   _create_backup_marker(w->dir, vg->name, vg->seqno)) {
+		dm_list_add(&w->jobs, &job->list);
+		job = NULL;
+	}
+
+	if (!job && !w->running) {
+		/* A finished thread no longer holds the lock */
+		if (w->started && pthread_join(w->thread, NULL))
+			stack;
+		w->started = 0;
+		if (pthread_create(&w->thread, NULL, _backup_writer_thread, w)) {
+			/* Write synchronously instead */
+			log_sys_error("pthread_create", "backup writer");
+			job = dm_list_item(dm_list_first(&w->jobs), struct backup_job);
+			dm_list_del(&job->list);
+		} else
+			w->started = w->running = 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	if (job)
+		goto bad;
+
+	log_verbose("Deferring %s of volume group \"%s\" (seqno %u).",
+		    archive_name ? "archive" : "backup", vg->name, vg->seqno);
+
+	r = 1;
+bad:
+	if (job)
+		_free_backup_job(job);
+
+	return r;
+}
+
+static int _defer_archive(struct volume_group *vg)
+{
+	struct archive_params *ap = vg->cmd->archive_params;
+	char archive_name[PATH_MAX];
+	char *desc;
+
+	if (!(desc = _build_desc(vg->cmd->mem, vg->cmd->cmd_line, 1)) ||
+	    !archive_reserve(vg, ap->dir, ap->keep_days, ap->keep_number,
+			     archive_name, sizeof(archive_name)))
+		return_0;
+
+	if (_defer_write(vg, desc, archive_name))
+		return 1;
+
+	if (unlink(archive_name))
+		log_sys_debug("unlink", archive_name);
+
+	return 0;
+}
+
+static int _defer_backup(struct volume_group *vg)
+{
+	char *desc;
+
+	if (!(desc = _build_desc(vg->cmd->mem, vg->cmd->cmd_line, 0)))
+		return_0;
+
+	return _defer_write(vg, desc, NULL);
+}
+
+static void _remove_backup_marker(struct cmd_context *cmd, const char *vgname)
+{
+	char marker[PATH_MAX];
+
+	if (!_backup_path(marker, sizeof(marker), cmd->backup_params->dir,
+			  ".", vgname, ".pending"))
+		return;
+
+	if (unlink(marker) && errno != ENOENT)
+		log_sys_debug("unlink", marker);
+}
+
 int backup_init(struct cmd_context *cmd, const char *dir,
-		int enabled)
+		int defer, int enabled)
 {
 	backup_exit(cmd);
 
@@ -183,6 +600,11 @@ int backup_init(struct cmd_context *cmd, const char *dir,
 		log_error("Couldn't copy backup directory name.");
 		return 0;
 	}
+#ifdef DEBUG_MEM
+	/* Memory debugging is not thread-safe: write in the caller */
+	defer = 0;
+#endif
+	cmd->backup_params->defer = defer;
 	backup_enable(cmd, enabled);
 
 	return 1;
@@ -192,6 +614,7 @@ void backup_exit(struct cmd_context *cmd)
 {
 	if (!cmd->backup_params)
 		return;
+	_destroy_backup_writer(cmd);
 	dm_free(cmd->backup_params->dir);
 	memset(cmd->backup_params, 0, sizeof(*cmd->backup_params));
 }
@@ -239,15 +662,25 @@ int backup_locally(struct volume_group *vg)
 	    (errno == EROFS))
 		return 0;
 
+	if (vg->cmd->backup_params->defer && _defer_backup(vg))
+		return 1;
+
 	if (!__backup(vg)) {
 		log_error("Backup of volume group %s metadata failed.",
 			  vg->name);
 		return 0;
 	}
 
+	_remove_backup_marker(vg->cmd, vg->name);
+
 	return 1;
 }
 
+int backup_is_deferred(struct cmd_context *cmd)
+{
+	return cmd->backup_params->defer;
+}
+
 int backup(struct volume_group *vg)
 {
 	if (vg_is_clustered(vg))
@@ -261,6 +694,9 @@ int backup_remove(struct cmd_context *cmd, const char *vg_name)
 {
 	char path[PATH_MAX];
 
+	if (!backup_flush(cmd))
+		stack;
+
 	if (dm_snprintf(path, sizeof(path), "%s/%s",
 			 cmd->backup_params->dir, vg_name) < 0) {
 		log_error("Failed to generate backup filename (for removal).");
@@ -273,6 +709,8 @@ int backup_remove(struct cmd_context *cmd, const char *vg_name)
 	if (unlink(path))
 		log_sys_debug("unlink", path);
 
+	_remove_backup_marker(cmd, vg_name);
+
 	return 1;
 }
 
@@ -287,6 +725,9 @@ struct volume_group *backup_read_vg(struct cmd_context *cmd,
 				  .desc = cmd->cmd_line};
 	struct metadata_area *mda;
 
+	if (!backup_flush(cmd))
+		stack;
+
 	fic.type = FMT_INSTANCE_PRIVATE_MDAS;
 	fic.context.private = &tc;
 	if (!(tf = cmd->fmt_backup->ops->create_instance(cmd->fmt_backup, &fic))) {
@@ -399,6 +840,14 @@ int backup_restore(struct cmd_context *cmd, const char *vg_name, int force)
 {
 	char path[PATH_MAX];
 
+	if (!backup_flush(cmd))
+		stack;
+
+	if (_backup_path(path, sizeof(path), cmd->backup_params->dir, ".",
+			 vg_name, ".pending") && path_exists(path))
+		log_warn("WARNING: Deferred backup of volume group %s was interrupted. "
+			 "Backup may not hold the latest metadata.", vg_name);
+
 	if (dm_snprintf(path, sizeof(path), "%s/%s",
 			 cmd->backup_params->dir, vg_name) < 0) {
 		log_error("Failed to generate backup filename (for restore).");
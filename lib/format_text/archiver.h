@@ -41,13 +41,16 @@ int archive(struct volume_group *vg);
 int archive_display(struct cmd_context *cmd, const char *vg_name);
 int archive_display_file(struct cmd_context *cmd, const char *file);
 
-int backup_init(struct cmd_context *cmd, const char *dir, int enabled);
+int backup_init(struct cmd_context *cmd, const char *dir, int defer,
+		int enabled);
 void backup_exit(struct cmd_context *cmd);
 
 void backup_enable(struct cmd_context *cmd, int flag);
 int backup(struct volume_group *vg);
 int backup_locally(struct volume_group *vg);
 int backup_remove(struct cmd_context *cmd, const char *vg_name);
+int backup_flush(struct cmd_context *cmd);
+int backup_is_deferred(struct cmd_context *cmd);
 
 struct volume_group *backup_read_vg(struct cmd_context *cmd,
 				    const char *vg_name, const char *file);
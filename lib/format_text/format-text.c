@@ -42,8 +42,24 @@ static struct format_instance *_text_create_text_instance(const struct format_ty
 struct text_fid_context {
 	char *raw_metadata_buf;
 	uint32_t raw_metadata_buf_size;
+	uint32_t raw_metadata_buf_crc;
+	/* Metadata writes queued by _vg_write_raw for _text_vg_write_flush */
+	struct device_write *writes;
+	unsigned write_count;
+	unsigned write_size;
+	/* Last committed metadata text, the base for journal records */
+	char *journal_text;
+	uint32_t journal_text_size;
+	uint32_t journal_text_crc;
+	/* Journal record turning journal_text into raw_metadata_buf */
+	char *journal_record;
+	uint32_t journal_record_size;
+	unsigned journal_record_done;
 };
 
+/* Write a full copy once an mda holds this many journal records */
+#define JOURNAL_MAX_RECORDS 32
+
 struct dir_list {
 	struct dm_list list;
 	char dir[0];
@@ -54,6 +70,35 @@ struct raw_list {
 	struct device_area dev_area;
 };
 
+static int _journal_enabled(struct format_instance *fid)
+{
+	return find_config_tree_bool(fid->fmt->cmd, metadata_journal_CFG, NULL);
+}
+
+static void _free_raw_metadata_buf(struct text_fid_context *fidtc)
+{
+	dm_free(fidtc->raw_metadata_buf);
+	fidtc->raw_metadata_buf = NULL;
+	dm_free(fidtc->journal_record);
+	fidtc->journal_record = NULL;
+	fidtc->journal_record_done = 0;
+}
+
+/* Hold on to committed text as the base for the next journal record */
+static void _keep_journal_text(struct text_fid_context *fidtc,
+			       char **text, uint32_t size, uint32_t crc)
+{
+	if (fidtc->journal_text && fidtc->journal_text_size == size &&
+	    fidtc->journal_text_crc == crc)
+		return;
+
+	dm_free(fidtc->journal_text);
+	fidtc->journal_text = *text;
+	fidtc->journal_text_size = size;
+	fidtc->journal_text_crc = crc;
+	*text = NULL;
+}
+
 int rlocn_is_ignored(const struct raw_locn *rlocn)
 {
 	return (rlocn->flags & RAW_LOCN_IGNORED ? 1 : 0);
@@ -346,7 +391,8 @@ struct mda_header *raw_read_mda_header(const struct format_type *fmt,
 		goto bad;
 	}
 
-	if (mdah->version != FMTT_VERSION) {
+	if (mdah->version != FMTT_VERSION &&
+	    mdah->version != FMTT_VERSION_JOURNAL) {
 		log_error("Incompatible metadata area header version: %d on %s"
 			  " at offset %"PRIu64, mdah->version,
 			  dev_name(dev_area->dev), dev_area->start);
@@ -372,7 +418,9 @@ static int _raw_write_mda_header(const struct format_type *fmt,
 				 uint64_t start_byte, struct mda_header *mdah)
 {
 	strncpy((char *)mdah->magic, FMTT_MAGIC, sizeof(mdah->magic));
-	mdah->version = FMTT_VERSION;
+	/* Keep older tools from misreading journaled metadata */
+	mdah->version = ((mdah->raw_locns[0].flags | mdah->raw_locns[1].flags) &
+			 RAW_LOCN_JOURNAL) ? FMTT_VERSION_JOURNAL : FMTT_VERSION;
 	mdah->start = start_byte;
 
 	_xlate_mdah(mdah);
@@ -401,7 +449,8 @@ static struct raw_locn *_find_vg_rlocn(struct device_area *dev_area,
 
 	/* Should we use precommitted metadata? */
 	if (*precommitted && rlocn_precommitted->size &&
-	    (rlocn_precommitted->offset != rlocn->offset)) {
+	    ((rlocn_precommitted->offset != rlocn->offset) ||
+	     (rlocn_precommitted->size != rlocn->size))) {
 		rlocn = rlocn_precommitted;
 	} else
 		*precommitted = 0;
@@ -478,17 +527,83 @@ static int _raw_holds_vgname(struct format_instance *fid,
 	return r;
 }
 
+/*
+ * Read the text at rlocn into a new buffer, replaying any journal
+ * records, and describe it in journal if that is supplied.
+ */
+static char *_read_rlocn_text(struct device_area *area, struct mda_header *mdah,
+			      struct raw_locn *rlocn, uint32_t *size,
+			      struct mda_journal *journal)
+{
+	char *buf;
+	uint32_t wrap = 0, text_crc, base_size, records = 0;
+
+	if (rlocn->offset + rlocn->size > mdah->size)
+		wrap = (uint32_t) ((rlocn->offset + rlocn->size) - mdah->size);
+
+	if (wrap > rlocn->offset) {
+		log_error("%s: metadata too large for circular buffer",
+			  dev_name(area->dev));
+		return NULL;
+	}
+
+	/* FIXME 64-bit */
+	*size = (uint32_t) rlocn->size;
+
+	if (!(buf = dm_malloc(*size))) {
+		log_error("Failed to allocate metadata buffer.");
+		return NULL;
+	}
+
+	if (!dev_read_circular(area->dev, area->start + rlocn->offset,
+			       *size - wrap, area->start + MDA_HEADER_SIZE,
+			       wrap, buf))
+		goto_bad;
+
+	if (calc_crc(INITIAL_CRC, (uint8_t *)buf, *size) != rlocn->checksum) {
+		log_error("%s: Checksum error", dev_name(area->dev));
+		goto bad;
+	}
+
+	text_crc = rlocn->checksum;
+	base_size = *size;
+
+	if ((rlocn->flags & RAW_LOCN_JOURNAL) &&
+	    !journal_replay(&buf, size, &text_crc, &base_size, &records)) {
+		log_error("%s: Failed to replay metadata journal",
+			  dev_name(area->dev));
+		goto bad;
+	}
+
+	if (journal) {
+		journal->rlocn = *rlocn;
+		journal->text_crc = text_crc;
+		journal->base_size = base_size;
+		journal->records = records;
+	}
+
+	return buf;
+
+bad:
+	dm_free(buf);
+	return NULL;
+}
+
 static struct volume_group *_vg_read_raw_area(struct format_instance *fid,
 					      const char *vgname,
 					      struct device_area *area,
+					      struct mda_context *mdac,
 					      int precommitted,
 					      int single_device)
 {
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
 	struct volume_group *vg = NULL;
 	struct raw_locn *rlocn;
 	struct mda_header *mdah;
 	time_t when;
 	char *desc;
+	char *buf;
+	uint32_t size;
 	uint32_t wrap = 0;
 
 	if (!(mdah = raw_read_mda_header(fid->fmt, area)))
@@ -499,23 +614,43 @@ static struct volume_group *_vg_read_raw_area(struct format_instance *fid,
 		goto out;
 	}
 
-	if (rlocn->offset + rlocn->size > mdah->size)
-		wrap = (uint32_t) ((rlocn->offset + rlocn->size) - mdah->size);
+	/*
+	 * Journaled text needs replaying and, with journaling enabled,
+	 * committed text is kept as the base for the next record.
+	 */
+	if ((rlocn->flags & RAW_LOCN_JOURNAL) || (mdac && _journal_enabled(fid))) {
+		if (!(buf = _read_rlocn_text(area, mdah, rlocn, &size,
+					     mdac ? &mdac->journal : NULL)))
+			goto_out;
 
-	if (wrap > rlocn->offset) {
-		log_error("VG %s metadata too large for circular buffer",
-			  vgname);
-		goto out;
-	}
+		if ((vg = text_vg_import_buf(fid, single_device, buf, size,
+					     &when, &desc)) &&
+		    mdac && _journal_enabled(fid))
+			_keep_journal_text(fidtc, &buf, size, mdac->journal.text_crc);
 
-	/* FIXME 64-bit */
-	if (!(vg = text_vg_import_fd(fid, NULL, single_device, area->dev, 
-				     (off_t) (area->start + rlocn->offset),
-				     (uint32_t) (rlocn->size - wrap),
-				     (off_t) (area->start + MDA_HEADER_SIZE),
-				     wrap, calc_crc, rlocn->checksum, &when,
-				     &desc)))
-		goto_out;
+		dm_free(buf);
+
+		if (!vg)
+			goto_out;
+	} else {
+		if (rlocn->offset + rlocn->size > mdah->size)
+			wrap = (uint32_t) ((rlocn->offset + rlocn->size) - mdah->size);
+
+		if (wrap > rlocn->offset) {
+			log_error("VG %s metadata too large for circular buffer",
+				  vgname);
+			goto out;
+		}
+
+		/* FIXME 64-bit */
+		if (!(vg = text_vg_import_fd(fid, NULL, single_device, area->dev,
+					     (off_t) (area->start + rlocn->offset),
+					     (uint32_t) (rlocn->size - wrap),
+					     (off_t) (area->start + MDA_HEADER_SIZE),
+					     wrap, calc_crc, rlocn->checksum, &when,
+					     &desc)))
+			goto_out;
+	}
 	log_debug_metadata("Read %s %smetadata (%u) from %s at %" PRIu64 " size %"
 			   PRIu64, vg->name, precommitted ? "pre-commit " : "",
 			   vg->seqno, dev_name(area->dev),
@@ -528,6 +663,44 @@ static struct volume_group *_vg_read_raw_area(struct format_instance *fid,
 	return vg;
 }
 
+static int _vg_read_checksum_raw(struct format_instance *fid,
+				 const char *vgname,
+				 struct metadata_area *mda,
+				 uint32_t *checksum, uint32_t *size)
+{
+	struct mda_context *mdac = (struct mda_context *) mda->metadata_locn;
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
+	struct raw_locn *rlocn;
+	struct mda_header *mdah;
+	int precommitted = 0;
+	char *buf = NULL;
+	int r = 0;
+
+	if (!dev_open_readonly(mdac->area.dev))
+		return_0;
+
+	/*
+	 * The mda is not imported if its text matches, so record the
+	 * journal state here as _vg_read_raw_area() would.
+	 */
+	if ((mdah = raw_read_mda_header(fid->fmt, &mdac->area)) &&
+	    (rlocn = _find_vg_rlocn(&mdac->area, mdah, vgname, &precommitted)) &&
+	    (buf = _read_rlocn_text(&mdac->area, mdah, rlocn, size,
+				    &mdac->journal))) {
+		*checksum = mdac->journal.text_crc;
+		if (_journal_enabled(fid))
+			_keep_journal_text(fidtc, &buf, *size, *checksum);
+		r = 1;
+	}
+
+	if (!dev_close(mdac->area.dev))
+		stack;
+
+	dm_free(buf);
+
+	return r;
+}
+
 static struct volume_group *_vg_read_raw(struct format_instance *fid,
 					 const char *vgname,
 					 struct metadata_area *mda,
@@ -539,7 +712,7 @@ static struct volume_group *_vg_read_raw(struct format_instance *fid,
 	if (!dev_open_readonly(mdac->area.dev))
 		return_NULL;
 
-	vg = _vg_read_raw_area(fid, vgname, &mdac->area, 0, single_device);
+	vg = _vg_read_raw_area(fid, vgname, &mdac->area, mdac, 0, single_device);
 
 	if (!dev_close(mdac->area.dev))
 		stack;
@@ -557,7 +730,7 @@ static struct volume_group *_vg_read_precommit_raw(struct format_instance *fid,
 	if (!dev_open_readonly(mdac->area.dev))
 		return_NULL;
 
-	vg = _vg_read_raw_area(fid, vgname, &mdac->area, 1, 0);
+	vg = _vg_read_raw_area(fid, vgname, &mdac->area, NULL, 1, 0);
 
 	if (!dev_close(mdac->area.dev))
 		stack;
@@ -565,6 +738,120 @@ static struct volume_group *_vg_read_precommit_raw(struct format_instance *fid,
 	return vg;
 }
 
+static int _queue_write(struct format_instance *fid, struct device *dev,
+			uint64_t offset, size_t len, const char *buffer)
+{
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
+	struct device_write *writes;
+	unsigned size;
+
+	if (fidtc->write_count == fidtc->write_size) {
+		size = 2 * dm_list_size(&fid->metadata_areas_in_use);
+		if (size < 2 * fidtc->write_size)
+			size = 2 * fidtc->write_size;
+
+		if (!(writes = dm_pool_alloc(fid->mem, size * sizeof(*writes)))) {
+			log_error("Failed to allocate metadata write queue.");
+			return 0;
+		}
+
+		if (fidtc->write_count)
+			memcpy(writes, fidtc->writes,
+			       fidtc->write_count * sizeof(*writes));
+		fidtc->writes = writes;
+		fidtc->write_size = size;
+	}
+
+	writes = &fidtc->writes[fidtc->write_count++];
+	writes->where.dev = dev;
+	writes->where.start = offset;
+	writes->where.size = len;
+	writes->buffer = buffer;
+
+	return 1;
+}
+
+/*
+ * Append a journal record after the committed text at rlocn instead of
+ * writing a full copy.  Returns 0 if a full copy is needed instead
+ * and -1 on error.
+ */
+static int _vg_write_journal(struct format_instance *fid, struct volume_group *vg,
+			     struct mda_context *mdac, struct mda_header *mdah,
+			     struct raw_locn *rlocn)
+{
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
+	struct mda_journal *journal = &mdac->journal;
+	uint64_t buffer_size = mdah->size - MDA_HEADER_SIZE;
+	uint64_t offset, span, len, wrap = 0;
+
+	if (!rlocn || vg->old_name || !fidtc->journal_text ||
+	    !_journal_enabled(fid) ||
+	    journal->rlocn.offset != rlocn->offset ||
+	    journal->rlocn.size != rlocn->size ||
+	    journal->rlocn.checksum != rlocn->checksum ||
+	    journal->text_crc != fidtc->journal_text_crc ||
+	    journal->records >= JOURNAL_MAX_RECORDS)
+		return 0;
+
+	/* One record serves every mda holding the same text */
+	if (!fidtc->journal_record_done) {
+		fidtc->journal_record_done = 1;
+		fidtc->journal_record_size =
+			journal_delta(fidtc->journal_text, fidtc->journal_text_size,
+				      fidtc->raw_metadata_buf,
+				      fidtc->raw_metadata_buf_size,
+				      fidtc->raw_metadata_buf_crc,
+				      fidtc->raw_metadata_buf_size / 2,
+				      &fidtc->journal_record);
+	}
+
+	if (!(len = fidtc->journal_record_size))
+		return 0;
+
+	/* Compact once records outgrow half the base or space runs short */
+	span = rlocn->size + len;
+	if (span - journal->base_size > journal->base_size / 2 ||
+	    span + fidtc->raw_metadata_buf_size + 2 * SECTOR_SIZE > buffer_size)
+		return 0;
+
+	offset = rlocn->offset + rlocn->size;
+	if (offset >= mdah->size)
+		offset -= buffer_size;
+
+	if (offset + len > mdah->size)
+		wrap = offset + len - mdah->size;
+
+	log_debug_metadata("Appending %s metadata journal record to %s at %"
+			   PRIu64 " len %" PRIu64, vg->name,
+			   dev_name(mdac->area.dev), mdac->area.start + offset,
+			   len - wrap);
+
+	if (!_queue_write(fid, mdac->area.dev, mdac->area.start + offset,
+			  (size_t) (len - wrap), fidtc->journal_record) ||
+	    (wrap && !_queue_write(fid, mdac->area.dev,
+				   mdac->area.start + MDA_HEADER_SIZE,
+				   (size_t) wrap,
+				   fidtc->journal_record + len - wrap))) {
+		stack;
+		return -1;
+	}
+
+	mdac->rlocn.offset = rlocn->offset;
+	mdac->rlocn.size = span;
+	mdac->rlocn.checksum = calc_crc(rlocn->checksum,
+					(uint8_t *)fidtc->journal_record, len);
+	mdac->rlocn.flags = RAW_LOCN_JOURNAL;
+	journal->next_base_size = journal->base_size;
+	journal->next_records = journal->records + 1;
+
+	return 1;
+}
+
+/*
+ * Metadata text is written by _text_vg_write_flush once every
+ * metadata area has been through _vg_write_raw.
+ */
 static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 			 struct metadata_area *mda)
 {
@@ -576,6 +863,7 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 	int r = 0;
        uint64_t new_wrap = 0, old_wrap = 0, new_end;
 	int found = 0;
+	int journaled;
 	int noprecommit = 0;
 
 	/* Ignore any mda on a PV outside the VG. vgsplit relies on this */
@@ -599,14 +887,28 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 			vg->old_name ? vg->old_name : vg->name, &noprecommit);
 	mdac->rlocn.offset = _next_rlocn_offset(rlocn, mdah);
 
-	if (!fidtc->raw_metadata_buf &&
-	    !(fidtc->raw_metadata_buf_size =
-			text_vg_export_raw(vg, "", &fidtc->raw_metadata_buf))) {
-		log_error("VG %s metadata writing failed", vg->name);
+	if (!fidtc->raw_metadata_buf) {
+		if (!(fidtc->raw_metadata_buf_size =
+		      text_vg_export_raw(vg, "", &fidtc->raw_metadata_buf))) {
+			log_error("VG %s metadata writing failed", vg->name);
+			goto out;
+		}
+		/* Wrapped copies checksum the same as the whole buffer */
+		fidtc->raw_metadata_buf_crc =
+			calc_crc(INITIAL_CRC, (uint8_t *)fidtc->raw_metadata_buf,
+				 fidtc->raw_metadata_buf_size);
+	}
+
+	if ((journaled = _vg_write_journal(fid, vg, mdac, mdah, rlocn))) {
+		if (journaled > 0)
+			r = 1;
 		goto out;
 	}
 
 	mdac->rlocn.size = fidtc->raw_metadata_buf_size;
+	mdac->rlocn.flags = 0;
+	mdac->journal.next_base_size = fidtc->raw_metadata_buf_size;
+	mdac->journal.next_records = 0;
 
 	if (mdac->rlocn.offset + mdac->rlocn.size > mdah->size)
 		new_wrap = (mdac->rlocn.offset + mdac->rlocn.size) - mdah->size;
@@ -630,9 +932,9 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 			    mdac->rlocn.offset, mdac->rlocn.size - new_wrap);
 
 	/* Write text out, circularly */
-	if (!dev_write(mdac->area.dev, mdac->area.start + mdac->rlocn.offset,
-		       (size_t) (mdac->rlocn.size - new_wrap),
-		       fidtc->raw_metadata_buf))
+	if (!_queue_write(fid, mdac->area.dev, mdac->area.start + mdac->rlocn.offset,
+			  (size_t) (mdac->rlocn.size - new_wrap),
+			  fidtc->raw_metadata_buf))
 		goto_out;
 
 	if (new_wrap) {
@@ -640,22 +942,15 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 				  dev_name(mdac->area.dev), mdac->area.start +
 				  MDA_HEADER_SIZE, new_wrap);
 
-		if (!dev_write(mdac->area.dev,
-			       mdac->area.start + MDA_HEADER_SIZE,
-			       (size_t) new_wrap,
-			       fidtc->raw_metadata_buf +
-			       mdac->rlocn.size - new_wrap))
+		if (!_queue_write(fid, mdac->area.dev,
+				  mdac->area.start + MDA_HEADER_SIZE,
+				  (size_t) new_wrap,
+				  fidtc->raw_metadata_buf +
+				  mdac->rlocn.size - new_wrap))
 			goto_out;
 	}
 
-	mdac->rlocn.checksum = calc_crc(INITIAL_CRC, (uint8_t *)fidtc->raw_metadata_buf,
-					(uint32_t) (mdac->rlocn.size -
-						    new_wrap));
-	if (new_wrap)
-		mdac->rlocn.checksum = calc_crc(mdac->rlocn.checksum,
-						(uint8_t *)fidtc->raw_metadata_buf +
-						mdac->rlocn.size -
-						new_wrap, (uint32_t) new_wrap);
+	mdac->rlocn.checksum = fidtc->raw_metadata_buf_crc;
 
 	r = 1;
 
@@ -664,15 +959,31 @@ static int _vg_write_raw(struct format_instance *fid, struct volume_group *vg,
 		if (!dev_close(mdac->area.dev))
 			stack;
 
-		if (fidtc->raw_metadata_buf) {
-			dm_free(fidtc->raw_metadata_buf);
-			fidtc->raw_metadata_buf = NULL;
-		}
+		_free_raw_metadata_buf(fidtc);
+		fidtc->write_count = 0;
 	}
 
 	return r;
 }
 
+/* Submit the metadata queued by _vg_write_raw to all devices at once */
+static int _text_vg_write_flush(struct format_instance *fid,
+				struct volume_group *vg)
+{
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
+	int r;
+
+	if (!fidtc || !fidtc->write_count)
+		return 1;
+
+	if (!(r = dev_write_batch(fidtc->writes, fidtc->write_count)))
+		log_error("Failed to write VG %s metadata.", vg->name);
+
+	fidtc->write_count = 0;
+
+	return r;
+}
+
 static int _vg_commit_raw_rlocn(struct format_instance *fid,
 				struct volume_group *vg,
 				struct metadata_area *mda,
@@ -682,6 +993,7 @@ static int _vg_commit_raw_rlocn(struct format_instance *fid,
 	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
 	struct mda_header *mdah;
 	struct raw_locn *rlocn;
+	struct raw_locn committed;
 	struct pv_list *pvl;
 	int r = 0;
 	int found = 0;
@@ -707,9 +1019,11 @@ static int _vg_commit_raw_rlocn(struct format_instance *fid,
 		mdah->raw_locns[0].offset = 0;
 		mdah->raw_locns[0].size = 0;
 		mdah->raw_locns[0].checksum = 0;
+		mdah->raw_locns[0].flags &= ~RAW_LOCN_JOURNAL;
 		mdah->raw_locns[1].offset = 0;
 		mdah->raw_locns[1].size = 0;
 		mdah->raw_locns[1].checksum = 0;
+		mdah->raw_locns[1].flags = 0;
 		mdah->raw_locns[2].offset = 0;
 		mdah->raw_locns[2].size = 0;
 		mdah->raw_locns[2].checksum = 0;
@@ -723,6 +1037,7 @@ static int _vg_commit_raw_rlocn(struct format_instance *fid,
 		mdah->raw_locns[1].offset = 0;
 		mdah->raw_locns[1].size = 0;
 		mdah->raw_locns[1].checksum = 0;
+		mdah->raw_locns[1].flags = 0;
 	}
 
 	/* Is there new metadata to commit? */
@@ -730,6 +1045,9 @@ static int _vg_commit_raw_rlocn(struct format_instance *fid,
 		rlocn->offset = mdac->rlocn.offset;
 		rlocn->size = mdac->rlocn.size;
 		rlocn->checksum = mdac->rlocn.checksum;
+		rlocn->flags = (rlocn->flags & ~RAW_LOCN_JOURNAL) |
+			       (mdac->rlocn.flags & RAW_LOCN_JOURNAL);
+		committed = *rlocn;
 		log_debug_metadata("%sCommitting %s metadata (%u) to %s header at %"
 			  PRIu64, precommit ? "Pre-" : "", vg->name, vg->seqno,
 			  dev_name(mdac->area.dev), mdac->area.start);
@@ -747,16 +1065,26 @@ static int _vg_commit_raw_rlocn(struct format_instance *fid,
 		goto out;
 	}
 
+	/* The committed text becomes the base for journal records */
+	if (!precommit && mdac->rlocn.size) {
+		mdac->journal.rlocn = committed;
+		mdac->journal.text_crc = fidtc->raw_metadata_buf_crc;
+		mdac->journal.base_size = mdac->journal.next_base_size;
+		mdac->journal.records = mdac->journal.next_records;
+		if (fidtc->raw_metadata_buf && _journal_enabled(fid))
+			_keep_journal_text(fidtc, &fidtc->raw_metadata_buf,
+					   fidtc->raw_metadata_buf_size,
+					   fidtc->raw_metadata_buf_crc);
+	}
+
 	r = 1;
 
       out:
 	if (!precommit) {
 		if (!dev_close(mdac->area.dev))
 			stack;
-		if (fidtc->raw_metadata_buf) {
-			dm_free(fidtc->raw_metadata_buf);
-			fidtc->raw_metadata_buf = NULL;
-		}
+		_free_raw_metadata_buf(fidtc);
+		fidtc->write_count = 0;
 	}
 
 	return r;
@@ -822,6 +1150,9 @@ static int _vg_remove_raw(struct format_instance *fid, struct volume_group *vg,
 	rlocn->offset = 0;
 	rlocn->size = 0;
 	rlocn->checksum = 0;
+	/* Nothing journaled remains, so the header reverts to version 1 */
+	mdah->raw_locns[0].flags &= ~RAW_LOCN_JOURNAL;
+	mdah->raw_locns[1].flags &= ~RAW_LOCN_JOURNAL;
 	rlocn_set_ignored(mdah->raw_locns, mda_is_ignored(mda));
 
 	if (!_raw_write_mda_header(fid->fmt, mdac->area.dev, mdac->area.start,
@@ -1121,6 +1452,8 @@ const char *vgname_from_mda(const struct format_type *fmt,
 	unsigned int len = 0;
 	char buf[NAME_LEN + 1] __attribute__((aligned(8)));
 	char uuid[64] __attribute__((aligned(8)));
+	char *text;
+	uint32_t size;
 	uint64_t buffer_size, current_usage;
 
 	if (mda_free_sectors)
@@ -1156,25 +1489,37 @@ const char *vgname_from_mda(const struct format_type *fmt,
 		goto_out;
 
 	/* We found a VG - now check the metadata */
-	if (rlocn->offset + rlocn->size > mdah->size)
-		wrap = (uint32_t) ((rlocn->offset + rlocn->size) - mdah->size);
+	if (rlocn->flags & RAW_LOCN_JOURNAL) {
+		if (!(text = _read_rlocn_text(dev_area, mdah, rlocn, &size, NULL)))
+			goto_out;
 
-	if (wrap > rlocn->offset) {
-		log_error("%s: metadata too large for circular buffer",
-			  dev_name(dev_area->dev));
-		goto out;
-	}
+		vgname = text_vgname_import_buf(fmt, text, size, vgid, vgstatus,
+						creation_host);
+		dm_free(text);
 
-	/* FIXME 64-bit */
-	if (!(vgname = text_vgname_import(fmt, dev_area->dev,
-					  (off_t) (dev_area->start +
-						   rlocn->offset),
-					  (uint32_t) (rlocn->size - wrap),
-					  (off_t) (dev_area->start +
-						   MDA_HEADER_SIZE),
-					  wrap, calc_crc, rlocn->checksum,
-					  vgid, vgstatus, creation_host)))
-		goto_out;
+		if (!vgname)
+			goto_out;
+	} else {
+		if (rlocn->offset + rlocn->size > mdah->size)
+			wrap = (uint32_t) ((rlocn->offset + rlocn->size) - mdah->size);
+
+		if (wrap > rlocn->offset) {
+			log_error("%s: metadata too large for circular buffer",
+				  dev_name(dev_area->dev));
+			goto out;
+		}
+
+		/* FIXME 64-bit */
+		if (!(vgname = text_vgname_import(fmt, dev_area->dev,
+						  (off_t) (dev_area->start +
+							   rlocn->offset),
+						  (uint32_t) (rlocn->size - wrap),
+						  (off_t) (dev_area->start +
+							   MDA_HEADER_SIZE),
+						  wrap, calc_crc, rlocn->checksum,
+						  vgid, vgstatus, creation_host)))
+			goto_out;
+	}
 
 	/* Ignore this entry if the characters aren't permissible */
 	if (!validate_name(vgname)) {
@@ -1240,7 +1585,7 @@ static int _scan_raw(const struct format_type *fmt, const char *vgname __attribu
 		if ((scanned_vgname = vgname_from_mda(fmt, mdah,
 					      &rl->dev_area, &vgid, &vgstatus,
 					      NULL, NULL))) {
-			vg = _vg_read_raw_area(&fid, scanned_vgname, &rl->dev_area, 0, 0);
+			vg = _vg_read_raw_area(&fid, scanned_vgname, &rl->dev_area, NULL, 0, 0);
 			if (vg)
 				lvmcache_update_vg(vg, 0);
 
@@ -1580,7 +1925,14 @@ static int _text_pv_initialise(const struct format_type *fmt,
 
 static void _text_destroy_instance(struct format_instance *fid)
 {
+	struct text_fid_context *fidtc = (struct text_fid_context *) fid->private;
+
 	if (--fid->ref_count <= 1) {
+		if (fidtc) {
+			_free_raw_metadata_buf(fidtc);
+			dm_free(fidtc->journal_text);
+			fidtc->journal_text = NULL;
+		}
 		if (fid->metadata_areas_index)
 			dm_hash_destroy(fid->metadata_areas_index);
 		dm_pool_destroy(fid->mem);
@@ -1644,6 +1996,7 @@ static int _mda_import_text_raw(struct lvmcache_info *info, const struct dm_conf
 static struct metadata_area_ops _metadata_text_raw_ops = {
 	.vg_read = _vg_read_raw,
 	.vg_read_precommit = _vg_read_precommit_raw,
+	.vg_read_checksum = _vg_read_checksum_raw,
 	.vg_write = _vg_write_raw,
 	.vg_remove = _vg_remove_raw,
 	.vg_precommit = _vg_precommit_raw,
@@ -2313,6 +2666,7 @@ static struct format_handler _text_handler = {
 	.pv_resize = _text_pv_resize,
 	.pv_write = _text_pv_write,
 	.vg_setup = _text_vg_setup,
+	.vg_write_flush = _text_vg_write_flush,
 	.lv_setup = _text_lv_setup,
 	.create_instance = _text_create_text_instance,
 	.destroy_instance = _text_destroy_instance,
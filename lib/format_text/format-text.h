@@ -34,6 +34,14 @@ int archive_vg(struct volume_group *vg,
 	       const char *dir,
 	       const char *desc, uint32_t retain_days, uint32_t min_archive);
 
+/*
+ * Creates the next archive file of a vg empty and records it like
+ * archive_vg does, returning its path.  The caller fills it in later.
+ */
+int archive_reserve(struct volume_group *vg, const char *dir,
+		    uint32_t retain_days, uint32_t min_archive,
+		    char *archive_name, size_t size);
+
 /*
  * Displays a list of vg backups in a particular archive directory.
  */
@@ -85,5 +85,13 @@ const char *text_vgname_import(const struct format_type *fmt,
                                checksum_fn_t checksum_fn, uint32_t checksum,
                                struct id *vgid, uint64_t *vgstatus,
 			       char **creation_host);
+struct volume_group *text_vg_import_buf(struct format_instance *fid,
+					int single_device,
+					const char *buf, uint32_t size,
+					time_t *when, char **desc);
+const char *text_vgname_import_buf(const struct format_type *fmt,
+				   const char *buf, uint32_t size,
+				   struct id *vgid, uint64_t *vgstatus,
+				   char **creation_host);
 
 #endif
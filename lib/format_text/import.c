@@ -32,6 +32,52 @@ static void _init_text_import(void)
 	_text_import_initialised = 1;
 }
 
+static const char *_vgname_from_cft(const struct format_type *fmt,
+				    const struct dm_config_tree *cft,
+				    struct id *vgid, uint64_t *vgstatus,
+				    char **creation_host)
+{
+	struct text_vg_version_ops **vsn;
+
+	/*
+	 * Find a set of version functions that can read this file
+	 */
+	for (vsn = &_text_vsn_list[0]; *vsn; vsn++) {
+		if (!(*vsn)->check_version(cft))
+			continue;
+
+		return (*vsn)->read_vgname(fmt, cft, vgid, vgstatus,
+					   creation_host);
+	}
+
+	return NULL;
+}
+
+static struct volume_group *_vg_from_cft(struct format_instance *fid,
+					 const struct dm_config_tree *cft,
+					 int single_device,
+					 time_t *when, char **desc)
+{
+	struct volume_group *vg;
+	struct text_vg_version_ops **vsn;
+
+	/*
+	 * Find a set of version functions that can read this file
+	 */
+	for (vsn = &_text_vsn_list[0]; *vsn; vsn++) {
+		if (!(*vsn)->check_version(cft))
+			continue;
+
+		if (!(vg = (*vsn)->read_vg(fid, cft, single_device)))
+			return_NULL;
+
+		(*vsn)->read_desc(vg->vgmem, cft, when, desc);
+		return vg;
+	}
+
+	return NULL;
+}
+
 const char *text_vgname_import(const struct format_type *fmt,
 			       struct device *dev,
 			       off_t offset, uint32_t size,
@@ -41,7 +87,6 @@ const char *text_vgname_import(const struct format_type *fmt,
 			       char **creation_host)
 {
 	struct dm_config_tree *cft;
-	struct text_vg_version_ops **vsn;
 	const char *vgname = NULL;
 
 	_init_text_import();
@@ -54,19 +99,33 @@ const char *text_vgname_import(const struct format_type *fmt,
 					 offset2, size2, checksum_fn, checksum)))
 		goto_out;
 
-	/*
-	 * Find a set of version functions that can read this file
-	 */
-	for (vsn = &_text_vsn_list[0]; *vsn; vsn++) {
-		if (!(*vsn)->check_version(cft))
-			continue;
+	if (!(vgname = _vgname_from_cft(fmt, cft, vgid, vgstatus, creation_host)))
+		stack;
 
-		if (!(vgname = (*vsn)->read_vgname(fmt, cft, vgid, vgstatus,
-						   creation_host)))
-			goto_out;
+      out:
+	config_destroy(cft);
+	return vgname;
+}
 
-		break;
-	}
+/* As text_vgname_import but from metadata text already in memory */
+const char *text_vgname_import_buf(const struct format_type *fmt,
+				   const char *buf, uint32_t size,
+				   struct id *vgid, uint64_t *vgstatus,
+				   char **creation_host)
+{
+	struct dm_config_tree *cft;
+	const char *vgname = NULL;
+
+	_init_text_import();
+
+	if (!(cft = config_open(CONFIG_FILE, NULL, 0)))
+		return_NULL;
+
+	if (!dm_config_parse(cft, buf, buf + size))
+		goto_out;
+
+	if (!(vgname = _vgname_from_cft(fmt, cft, vgid, vgstatus, creation_host)))
+		stack;
 
       out:
 	config_destroy(cft);
@@ -85,7 +144,6 @@ struct volume_group *text_vg_import_fd(struct format_instance *fid,
 {
 	struct volume_group *vg = NULL;
 	struct dm_config_tree *cft;
-	struct text_vg_version_ops **vsn;
 
 	_init_text_import();
 
@@ -102,20 +160,37 @@ struct volume_group *text_vg_import_fd(struct format_instance *fid,
 		goto out;
 	}
 
-	/*
-	 * Find a set of version functions that can read this file
-	 */
-	for (vsn = &_text_vsn_list[0]; *vsn; vsn++) {
-		if (!(*vsn)->check_version(cft))
-			continue;
+	vg = _vg_from_cft(fid, cft, single_device, when, desc);
 
-		if (!(vg = (*vsn)->read_vg(fid, cft, single_device)))
-			goto_out;
+      out:
+	config_destroy(cft);
+	return vg;
+}
 
-		(*vsn)->read_desc(vg->vgmem, cft, when, desc);
-		break;
+/* As text_vg_import_fd but from metadata text already in memory */
+struct volume_group *text_vg_import_buf(struct format_instance *fid,
+					int single_device,
+					const char *buf, uint32_t size,
+					time_t *when, char **desc)
+{
+	struct volume_group *vg = NULL;
+	struct dm_config_tree *cft;
+
+	_init_text_import();
+
+	*desc = NULL;
+	*when = 0;
+
+	if (!(cft = config_open(CONFIG_FILE, NULL, 0)))
+		return_NULL;
+
+	if (!dm_config_parse(cft, buf, buf + size)) {
+		log_error("Couldn't read volume group metadata.");
+		goto out;
 	}
 
+	vg = _vg_from_cft(fid, cft, single_device, when, desc);
+
       out:
 	config_destroy(cft);
 	return vg;
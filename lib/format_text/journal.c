@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU Lesser General Public License v.2.1.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "lib.h"
+#include "format-text.h"
+#include "layout.h"
+#include "crc.h"
+#include "xlate.h"
+
+/*
+ * A journaled metadata location holds the NUL-terminated text of a
+ * full base copy followed by delta records.  Each record rewrites the
+ * text before it with COPY (range of the previous text) and INSERT
+ * (literal bytes) operations.
+ *
+ * Deltas are found rsync-style: fixed blocks of the previous text are
+ * indexed by a rolling hash and matches are extended both ways.
+ */
+#define JOURNAL_MAGIC "LVMJRNL1"
+#define JOURNAL_BLOCK 64
+#define JOURNAL_HASH_MULT 0x01000193U
+#define JOURNAL_COPY_OP 0x80000000U
+#define JOURNAL_MAX_TEXT (UINT32_C(1) << 30)
+
+struct journal_slot {
+	uint32_t hash;
+	uint32_t block;		/* Block number + 1, 0 if unused */
+};
+
+struct journal_buf {
+	char *start;
+	uint32_t used;
+	uint32_t size;
+	uint32_t limit;
+};
+
+static uint32_t _hash_block(const char *p)
+{
+	uint32_t h = 0;
+	unsigned i;
+
+	for (i = 0; i < JOURNAL_BLOCK; i++)
+		h = h * JOURNAL_HASH_MULT + (unsigned char) p[i];
+
+	return h;
+}
+
+static uint32_t _slot_index(uint32_t hash, uint32_t mask)
+{
+	return (hash * 2654435761U) & mask;
+}
+
+static int _buf_append(struct journal_buf *b, const void *data, uint32_t len)
+{
+	char *n;
+	uint32_t size;
+
+	if (b->used + len > b->limit)
+		return 0;
+
+	if (b->used + len > b->size) {
+		size = b->size * 2;
+		while (size < b->used + len)
+			size *= 2;
+		if (!(n = dm_realloc(b->start, size)))
+			return_0;
+		b->start = n;
+		b->size = size;
+	}
+
+	memcpy(b->start + b->used, data, len);
+	b->used += len;
+
+	return 1;
+}
+
+static int _emit_insert(struct journal_buf *b, const char *data, uint32_t len)
+{
+	uint32_t op = xlate32(len);
+
+	if (!len)
+		return 1;
+
+	return _buf_append(b, &op, sizeof(op)) && _buf_append(b, data, len);
+}
+
+static int _emit_copy(struct journal_buf *b, uint32_t offset, uint32_t len)
+{
+	uint32_t op[2] = { xlate32(JOURNAL_COPY_OP | len), xlate32(offset) };
+
+	return _buf_append(b, op, sizeof(op));
+}
+
+/*
+ * Build a record turning old into new.  Returns its size, or 0 if the
+ * record would be larger than limit and a full copy should be written.
+ */
+uint32_t journal_delta(const char *old, uint32_t old_size,
+		       const char *new, uint32_t new_size,
+		       uint32_t text_crc, uint32_t limit, char **record)
+{
+	struct journal_record rec;
+	struct journal_slot *slots = NULL, *slot;
+	struct journal_buf b = { .size = 4096, .limit = limit };
+	uint32_t blocks, mask, i, n, lit = 0, off, len, h = 0, out = 1;
+	uint32_t pow = 1;
+
+	blocks = old_size / JOURNAL_BLOCK;
+
+	for (mask = 1; mask < 2 * blocks; mask <<= 1)
+		;
+	mask--;
+
+	if (!(b.start = dm_malloc(b.size)) ||
+	    !(slots = dm_zalloc((mask + 1) * sizeof(*slots)))) {
+		log_error("Failed to allocate metadata journal delta.");
+		goto bad;
+	}
+
+	for (i = 0; i < JOURNAL_BLOCK - 1; i++)
+		pow *= JOURNAL_HASH_MULT;
+
+	for (i = 0; i < blocks; i++) {
+		h = _hash_block(old + i * JOURNAL_BLOCK);
+		for (n = _slot_index(h, mask); slots[n].block; n = (n + 1) & mask)
+			if (slots[n].hash == h)
+				break;
+		if (!slots[n].block) {
+			slots[n].hash = h;
+			slots[n].block = i + 1;
+		}
+	}
+
+	memset(&rec, 0, sizeof(rec));
+	if (!_buf_append(&b, &rec, sizeof(rec)))
+		goto bad;
+
+	for (i = 0; blocks && i + JOURNAL_BLOCK <= new_size; ) {
+		if (out)
+			h = _hash_block(new + i);
+		out = 0;
+
+		for (n = _slot_index(h, mask); (slot = &slots[n])->block; n = (n + 1) & mask)
+			if (slot->hash == h)
+				break;
+
+		off = (slot->block - 1) * JOURNAL_BLOCK;
+		if (!slot->block || memcmp(old + off, new + i, JOURNAL_BLOCK)) {
+			if (i + JOURNAL_BLOCK < new_size)
+				h = (h - pow * (unsigned char) new[i]) * JOURNAL_HASH_MULT +
+				    (unsigned char) new[i + JOURNAL_BLOCK];
+			i++;
+			continue;
+		}
+
+		len = JOURNAL_BLOCK;
+		while (i > lit && off && old[off - 1] == new[i - 1]) {
+			i--;
+			off--;
+			len++;
+		}
+		while (i + len < new_size && off + len < old_size &&
+		       old[off + len] == new[i + len])
+			len++;
+
+		if (!_emit_insert(&b, new + lit, i - lit) ||
+		    !_emit_copy(&b, off, len))
+			goto bad;
+
+		i += len;
+		lit = i;
+		out = 1;
+	}
+
+	if (!_emit_insert(&b, new + lit, new_size - lit))
+		goto bad;
+
+	memcpy(rec.magic, JOURNAL_MAGIC, sizeof(rec.magic));
+	rec.size_xl = xlate32(b.used - sizeof(rec));
+	rec.text_size_xl = xlate32(new_size);
+	rec.text_crc_xl = xlate32(text_crc);
+	memcpy(b.start, &rec, sizeof(rec));
+
+	dm_free(slots);
+	*record = b.start;
+
+	return b.used;
+
+bad:
+	dm_free(slots);
+	dm_free(b.start);
+
+	return 0;
+}
+
+static int _apply_record(const char *text, uint32_t text_size,
+			 const char *ops, uint32_t ops_size,
+			 char *new, uint32_t new_size)
+{
+	uint32_t p = 0, used = 0, op, len, off;
+
+	while (p < ops_size) {
+		if (ops_size - p < sizeof(op))
+			return 0;
+		memcpy(&op, ops + p, sizeof(op));
+		op = xlate32(op);
+		p += sizeof(op);
+		len = op & ~JOURNAL_COPY_OP;
+
+		if (len > new_size - used)
+			return 0;
+
+		if (op & JOURNAL_COPY_OP) {
+			if (ops_size - p < sizeof(off))
+				return 0;
+			memcpy(&off, ops + p, sizeof(off));
+			off = xlate32(off);
+			p += sizeof(off);
+
+			if (off > text_size || len > text_size - off)
+				return 0;
+			memcpy(new + used, text + off, len);
+		} else {
+			if (len > ops_size - p)
+				return 0;
+			memcpy(new + used, ops + p, len);
+			p += len;
+		}
+
+		used += len;
+	}
+
+	return used == new_size;
+}
+
+/*
+ * Replace the raw location contents in *buf by the text they describe.
+ * On success *size is the text size and *base_size and *records describe
+ * the journal; *text_crc is only set if there were records.
+ */
+int journal_replay(char **buf, uint32_t *size, uint32_t *text_crc,
+		   uint32_t *base_size, uint32_t *records)
+{
+	struct journal_record rec;
+	const char *span = *buf, *text;
+	char *new = NULL, *prev = NULL;
+	uint32_t span_size = *size, text_size, p, ops_size, new_size;
+
+	text = span;
+	text_size = strnlen(span, span_size) + 1;
+	if (text_size > span_size) {
+		log_error("Metadata journal base is not terminated.");
+		return 0;
+	}
+
+	*base_size = text_size;
+	*records = 0;
+
+	for (p = text_size; p < span_size; p += ops_size) {
+		if (span_size - p < sizeof(rec)) {
+			log_error("Truncated metadata journal record %u.", *records + 1);
+			goto bad;
+		}
+
+		memcpy(&rec, span + p, sizeof(rec));
+		p += sizeof(rec);
+		ops_size = xlate32(rec.size_xl);
+		new_size = xlate32(rec.text_size_xl);
+
+		if (memcmp(rec.magic, JOURNAL_MAGIC, sizeof(rec.magic)) ||
+		    ops_size > span_size - p ||
+		    !new_size || new_size > JOURNAL_MAX_TEXT) {
+			log_error("Invalid metadata journal record %u.", *records + 1);
+			goto bad;
+		}
+
+		if (!(new = dm_malloc(new_size))) {
+			log_error("Failed to allocate metadata journal text.");
+			goto bad;
+		}
+
+		if (!_apply_record(text, text_size, span + p, ops_size,
+				   new, new_size)) {
+			log_error("Corrupted metadata journal record %u.", *records + 1);
+			goto bad;
+		}
+
+		dm_free(prev);
+		prev = new;
+		text = new;
+		text_size = new_size;
+		*text_crc = xlate32(rec.text_crc_xl);
+		(*records)++;
+		new = NULL;
+	}
+
+	if (*records) {
+		if (calc_crc(INITIAL_CRC, (const uint8_t *) text, text_size) != *text_crc) {
+			log_error("Metadata journal checksum error.");
+			goto bad;
+		}
+		dm_free(*buf);
+		*buf = prev;
+	}
+
+	*size = text_size;
+
+	return 1;
+
+bad:
+	dm_free(new);
+	dm_free(prev);
+
+	return 0;
+}
@@ -52,6 +52,12 @@ struct pv_header {
  */
 #define RAW_LOCN_IGNORED 0x00000001
 
+/*
+ * Text at this raw location is a full copy followed by
+ * journal records.  See journal.c.
+ */
+#define RAW_LOCN_JOURNAL 0x00000002
+
 /* On disk */
 struct raw_locn {
 	uint64_t offset;	/* Offset in bytes to start sector */
@@ -85,15 +91,42 @@ struct mda_lists {
 	struct metadata_area_ops *raw_ops;
 };
 
+/* Committed metadata text of an mda that the format instance holds */
+struct mda_journal {
+	struct raw_locn rlocn;	/* Location the text was read from or written to */
+	uint32_t text_crc;
+	uint32_t base_size;	/* Size of the full copy at the start */
+	uint32_t records;
+	uint32_t next_base_size;	/* Store inbetween write and commit */
+	uint32_t next_records;
+};
+
 struct mda_context {
 	struct device_area area;
 	uint64_t free_sectors;
 	struct raw_locn rlocn;	/* Store inbetween write and commit */
+	struct mda_journal journal;
 };
 
+/* On disk */
+struct journal_record {
+	int8_t magic[8];
+	uint32_t size_xl;	/* Bytes of operations following */
+	uint32_t text_size_xl;	/* Resulting text including NUL */
+	uint32_t text_crc_xl;
+	uint32_t reserved_xl;
+} __attribute__ ((packed));
+
+uint32_t journal_delta(const char *old, uint32_t old_size,
+		       const char *new, uint32_t new_size,
+		       uint32_t text_crc, uint32_t limit, char **record);
+int journal_replay(char **buf, uint32_t *size, uint32_t *text_crc,
+		   uint32_t *base_size, uint32_t *records);
+
 /* FIXME Convert this at runtime */
 #define FMTT_MAGIC "\040\114\126\115\062\040\170\133\065\101\045\162\060\116\052\076"
 #define FMTT_VERSION 1
+#define FMTT_VERSION_JOURNAL 2	/* Some raw location is journaled */
 #define MDA_HEADER_SIZE 512
 #define LVM2_LABEL "LVM2 001"
 #define MDA_SIZE_MIN (8 * (unsigned) lvm_getpagesize())
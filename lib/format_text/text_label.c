@@ -281,6 +281,7 @@ int add_mda(const struct format_type *fmt, struct dm_pool *mem, struct dm_list *
 	mdac->area.size = size;
 	mdac->free_sectors = UINT64_C(0);
 	memset(&mdac->rlocn, 0, sizeof(mdac->rlocn));
+	memset(&mdac->journal, 0, sizeof(mdac->journal));
 	mda_set_ignored(mdal, ignored);
 
 	dm_list_add(mdas, &mdal->list);
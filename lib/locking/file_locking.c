@@ -343,6 +343,8 @@ int init_file_locking(struct locking_type *locking, struct cmd_context *cmd,
 	locking->lock_resource = _file_lock_resource;
 	locking->reset_locking = _reset_file_locking;
 	locking->fin_locking = _fin_file_locking;
+	locking->activate_lvs = lvs_activate_with_filter;
+	locking->deactivate_lvs = lvs_deactivate;
 	locking->flags = 0;
 
 	/* Get lockfile directory from config file */
@@ -22,6 +22,7 @@
 #include "memlock.h"
 #include "defaults.h"
 #include "lvmcache.h"
+#include "archiver.h"
 
 #include <assert.h>
 #include <signal.h>
@@ -232,6 +233,10 @@ int init_locking(int type, struct cmd_context *cmd, int suppress_messages)
 
 	_blocking_supported = find_config_tree_bool(cmd, global_wait_for_locks_CFG, NULL);
 
+	/* Only set by the types activating LVs in this process */
+	_locking.activate_lvs = NULL;
+	_locking.deactivate_lvs = NULL;
+
 	switch (type) {
 	case 0:
 		init_no_locking(&_locking, cmd, suppress_messages);
@@ -382,6 +387,11 @@ static int _lock_vol(struct cmd_context *cmd, const char *resource,
 		goto out;
 	}
 
+	/* Deferred metadata backups must complete while the VG is locked. */
+	if (lck_scope == LCK_VG && !(flags & LCK_CACHE) && lck_type == LCK_UNLOCK &&
+	    !is_orphan_vg(resource) && !is_global_vg(resource) && !backup_flush(cmd))
+		stack;
+
 	if ((ret = _locking.lock_resource(cmd, resource, flags, lv))) {
 		if (lck_scope == LCK_VG && !(flags & LCK_CACHE)) {
 			if (lck_type != LCK_UNLOCK)
@@ -601,6 +611,57 @@ int locking_is_clustered(void)
 	return (_locking.flags & LCK_CLUSTERED) ? 1 : 0;
 }
 
+/*
+ * Can LVs be (de)activated together in this process with
+ * activate_lvs_local() and deactivate_lvs_local()?
+ */
+int locking_activates_locally(void)
+{
+	return (_locking.activate_lvs && _locking.deactivate_lvs) ? 1 : 0;
+}
+
+/* Call fn with the bookkeeping _lock_vol() does around an LV lock */
+static int _lvs_local(struct cmd_context *cmd, struct dm_list *lvs,
+		      lvs_activation_fn fn, uint32_t flags)
+{
+	int r;
+
+	if (!fn || dm_list_empty(lvs))
+		return 0;
+
+	_block_signals(flags);
+	_lock_memory(cmd, LV_NOOP);
+
+	r = fn(cmd, lvs);
+
+	_unlock_memory(cmd, LV_NOOP);
+	_unblock_signals();
+
+	return r;
+}
+
+/*
+ * Activate a list of LVs of one VG together, as activate_lv_local()
+ * would one by one.  Returns 0 without activating anything if the
+ * locking type cannot do that or declines, so callers fall back to
+ * activating each LV.
+ */
+int activate_lvs_local(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	return _lvs_local(cmd, lvs, _locking.activate_lvs,
+			  LCK_LV_ACTIVATE | LCK_HOLD);
+}
+
+/*
+ * Deactivate a list of LVs of one VG together, as deactivate_lv_local()
+ * would one by one.  Returns 0 if any of them is left active.
+ */
+int deactivate_lvs_local(struct cmd_context *cmd, struct dm_list *lvs)
+{
+	return _lvs_local(cmd, lvs, _locking.deactivate_lvs,
+			  LCK_LV_DEACTIVATE);
+}
+
 int remote_lock_held(const char *vol, int *exclusive)
 {
 	int mode = LCK_NULL;
@@ -26,6 +26,7 @@ void fin_locking(void);
 void reset_locking(void);
 int vg_write_lock_held(void);
 int locking_is_clustered(void);
+int locking_activates_locally(void);
 
 int remote_lock_held(const char *vol, int *exclusive);
 
@@ -212,6 +213,8 @@ int suspend_lvs(struct cmd_context *cmd, struct dm_list *lvs,
 int resume_lvs(struct cmd_context *cmd, struct dm_list *lvs);
 int revert_lvs(struct cmd_context *cmd, struct dm_list *lvs);
 int activate_lvs(struct cmd_context *cmd, struct dm_list *lvs, unsigned exclusive);
+int activate_lvs_local(struct cmd_context *cmd, struct dm_list *lvs);
+int deactivate_lvs_local(struct cmd_context *cmd, struct dm_list *lvs);
 
 /* Interrupt handling */
 void sigint_clear(void);
@@ -19,6 +19,7 @@
 typedef int (*lock_resource_fn) (struct cmd_context * cmd, const char *resource,
 				 uint32_t flags, struct logical_volume *lv);
 typedef int (*query_resource_fn) (const char *resource, int *mode);
+typedef int (*lvs_activation_fn) (struct cmd_context * cmd, struct dm_list *lvs);
 
 typedef void (*fin_lock_fn) (void);
 typedef void (*reset_lock_fn) (void);
@@ -30,6 +31,9 @@ struct locking_type {
 	uint32_t flags;
 	lock_resource_fn lock_resource;
 	query_resource_fn query_resource;
+	/* Optional, for types activating LVs in this process only */
+	lvs_activation_fn activate_lvs;
+	lvs_activation_fn deactivate_lvs;
 
 	reset_lock_fn reset_locking;
 	fin_lock_fn fin_locking;
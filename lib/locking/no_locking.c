@@ -99,6 +99,8 @@ int init_readonly_locking(struct locking_type *locking, struct cmd_context *cmd
 	locking->lock_resource = _readonly_lock_resource;
 	locking->reset_locking = _no_reset_locking;
 	locking->fin_locking = _no_fin_locking;
+	locking->activate_lvs = lvs_activate_with_filter;
+	locking->deactivate_lvs = lvs_deactivate;
 	locking->flags = 0;
 
 	return 1;
@@ -4293,6 +4293,8 @@ int link_lv_to_vg(struct volume_group *vg, struct logical_volume *lv)
 	lvl->lv = lv;
 	lv->vg = vg;
 	dm_list_add(&vg->lvs, &lvl->list);
+	vg_index_add(vg->lv_names, &lvl->list);
+	vg_index_add(vg->lv_ids, &lvl->list);
 
 	return 1;
 }
@@ -4304,6 +4306,8 @@ int unlink_lv_from_vg(struct logical_volume *lv)
 	if (!(lvl = find_lv_in_vg(lv->vg, lv->name)))
 		return_0;
 
+	vg_index_del(lv->vg->lv_names, &lvl->list);
+	vg_index_del(lv->vg->lv_ids, &lvl->list);
 	dm_list_del(&lvl->list);
 
 	return 1;
@@ -35,6 +35,19 @@ static int _merge(struct lv_segment *first, struct lv_segment *second)
 	return first->segtype->ops->merge_segments(first, second);
 }
 
+/*
+ * Test whether 'second' could be merged into 'first'
+ * without modifying either of them.
+ */
+int lv_segments_compatible(struct lv_segment *first, struct lv_segment *second)
+{
+	if (!first || !second || first->segtype != second->segtype ||
+	    !first->segtype->ops->segments_compatible)
+		return 0;
+
+	return first->segtype->ops->segments_compatible(first, second);
+}
+
 int lv_merge_segments(struct logical_volume *lv)
 {
 	struct dm_list *segh, *t;
@@ -264,14 +264,10 @@ struct format_instance {
 /* There will be one area for each stripe */
 struct lv_segment_area {
 	area_type_t type;
+	uint32_t le;			/* AREA_LV: first LE used */
 	union {
-		struct {
-			struct pv_segment *pvseg;
-		} pv;
-		struct {
-			struct logical_volume *lv;
-			uint32_t le;
-		} lv;
+		struct pv_segment *pvseg;	/* AREA_PV */
+		struct logical_volume *lv;	/* AREA_LV */
 	} u;
 };
 
@@ -352,6 +348,7 @@ struct lv_segment {
 	uint32_t area_len;
 	uint32_t chunk_size;	/* For snapshots/thin_pool.  In sectors. */
 				/* For thin_pool, 128..2097152. */
+	uint32_t device_id;	/* For thin, 24bit */
 	struct logical_volume *origin;	/* snap and thin */
 	struct logical_volume *cow;
 	struct dm_list origin_list;
@@ -373,7 +370,6 @@ struct lv_segment {
 	struct dm_list thin_messages;		/* For thin_pool */
 	struct logical_volume *external_lv;	/* For thin */
 	struct logical_volume *pool_lv;		/* For thin */
-	uint32_t device_id;			/* For thin, 24bit */
 
 	struct logical_volume *replicator;/* For replicator-devs - link to replicator LV */
 	struct logical_volume *rlog_lv;	/* For replicators */
@@ -383,9 +379,9 @@ struct lv_segment {
 };
 
 #define seg_type(seg, s)	(seg)->areas[(s)].type
-#define seg_pv(seg, s)		(seg)->areas[(s)].u.pv.pvseg->pv
-#define seg_lv(seg, s)		(seg)->areas[(s)].u.lv.lv
-#define seg_metalv(seg, s)	(seg)->meta_areas[(s)].u.lv.lv
+#define seg_pv(seg, s)		(seg)->areas[(s)].u.pvseg->pv
+#define seg_lv(seg, s)		(seg)->areas[(s)].u.lv
+#define seg_metalv(seg, s)	(seg)->meta_areas[(s)].u.lv
 #define seg_metatype(seg, s)	(seg)->meta_areas[(s)].type
 
 struct pe_range {
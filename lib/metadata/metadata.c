@@ -146,6 +146,7 @@ out:
 void add_pvl_to_vgs(struct volume_group *vg, struct pv_list *pvl)
 {
 	dm_list_add(&vg->pvs, &pvl->list);
+	vg_index_add(vg->pv_ids, &pvl->list);
 	vg->pv_count++;
 	pvl->pv->vg = vg;
 	pv_set_fid(pvl->pv, vg->fid);
@@ -156,6 +157,7 @@ void del_pvl_from_vgs(struct volume_group *vg, struct pv_list *pvl)
 	struct lvmcache_info *info;
 
 	vg->pv_count--;
+	vg_index_del(vg->pv_ids, &pvl->list);
 	dm_list_del(&pvl->list);
 
 	pvl->pv->vg = vg->fid->fmt->orphan_vg; /* orphan */
@@ -830,6 +832,51 @@ int vgcreate_params_validate(struct cmd_context *cmd,
 	return 1;
 }
 
+/* Length of exported VG text without the trailing header and its timestamps */
+static size_t _vg_text_len(const char *text)
+{
+	const char *header = strstr(text, "\n# Generated by");
+
+	return header ? (size_t) (header - text) : strlen(text);
+}
+
+/*
+ * With internal checks enabled, compare the vg_copy() result against
+ * the text round trip it replaces.
+ */
+static void _check_vg_copy(struct volume_group *vg)
+{
+	struct dm_config_tree *cft;
+	struct volume_group *vg_rt;
+	char *copy_text = NULL, *rt_text = NULL;
+	size_t len;
+
+	if (!(cft = export_vg_to_config_tree(vg))) {
+		stack;
+		return;
+	}
+
+	vg_rt = import_vg_from_config_tree(cft, vg->fid);
+	dm_config_destroy(cft);
+
+	if (!vg_rt) {
+		stack;
+		return;
+	}
+
+	if (!export_vg_to_buffer(vg->vg_ondisk, &copy_text) ||
+	    !export_vg_to_buffer(vg_rt, &rt_text))
+		stack;
+	else if ((len = _vg_text_len(copy_text)) != _vg_text_len(rt_text) ||
+		 memcmp(copy_text, rt_text, len))
+		log_error(INTERNAL_ERROR "Copy of VG %s differs from its metadata.",
+			  vg->name);
+
+	dm_free(copy_text);
+	dm_free(rt_text);
+	release_vg(vg_rt);
+}
+
 static int _vg_update_vg_ondisk(struct volume_group *vg)
 {
 	struct dm_config_tree *cft;
@@ -842,12 +889,15 @@ static int _vg_update_vg_ondisk(struct volume_group *vg)
 	if (pool_locked && !dm_pool_unlock(vg->vgmem, 0))
 		return_0;
 
-	cft = export_vg_to_config_tree(vg);
-	if (!cft)
-		return 0;
+	/* Fall back to a text round trip for what vg_copy can't handle */
+	if (!(vg->vg_ondisk = vg_copy(vg, vg->fid))) {
+		if (!(cft = export_vg_to_config_tree(vg)))
+			return 0;
 
-	vg->vg_ondisk = import_vg_from_config_tree(cft, vg->fid);
-	dm_config_destroy(cft);
+		vg->vg_ondisk = import_vg_from_config_tree(cft, vg->fid);
+		dm_config_destroy(cft);
+	} else if (detect_internal_vg_cache_corruption())
+		_check_vg_copy(vg);
 
 	/* recompute the pool crc */
 	if (pool_locked && !dm_pool_lock(vg->vgmem, detect_internal_vg_cache_corruption()))
@@ -1703,9 +1753,10 @@ struct pv_list *find_pv_in_vg(const struct volume_group *vg,
 			       const char *pv_name)
 {
 	struct pv_list *pvl;
+	struct device *dev = dev_cache_get(pv_name, vg->cmd->filter);
 
 	dm_list_iterate_items(pvl, &vg->pvs)
-		if (pvl->pv->dev == dev_cache_get(pv_name, vg->cmd->filter))
+		if (pvl->pv->dev == dev)
 			return pvl;
 
 	return NULL;
@@ -1751,9 +1802,15 @@ struct pv_list *find_pv_in_vg_by_uuid(const struct volume_group *vg,
 {
 	struct pv_list *pvl;
 
+	if ((pvl = (struct pv_list *) vg_index_lookup(vg->pv_ids, id, sizeof(*id))) &&
+	    pvl->pv->vg == vg && id_equal(&pvl->pv->id, id))
+		return pvl;
+
 	dm_list_iterate_items(pvl, &vg->pvs)
-		if (id_equal(&pvl->pv->id, id))
+		if (id_equal(&pvl->pv->id, id)) {
+			vg_index_rebuild(vg->pv_ids);
 			return pvl;
+		}
 
 	return NULL;
 }
@@ -1770,9 +1827,16 @@ struct lv_list *find_lv_in_vg(const struct volume_group *vg,
 	else
 		ptr = lv_name;
 
+	if ((lvl = (struct lv_list *) vg_index_lookup(vg->lv_names, ptr, strlen(ptr) + 1)) &&
+	    lvl->lv->vg == vg && !strcmp(lvl->lv->name, ptr))
+		return lvl;
+
+	/* Not indexed or renamed since */
 	dm_list_iterate_items(lvl, &vg->lvs)
-		if (!strcmp(lvl->lv->name, ptr))
+		if (!strcmp(lvl->lv->name, ptr)) {
+			vg_index_rebuild(vg->lv_names);
 			return lvl;
+		}
 
 	return NULL;
 }
@@ -1794,9 +1858,15 @@ struct lv_list *find_lv_in_vg_by_lvid(struct volume_group *vg,
 {
 	struct lv_list *lvl;
 
+	if ((lvl = (struct lv_list *) vg_index_lookup(vg->lv_ids, lvid->id, sizeof(lvid->id))) &&
+	    lvl->lv->vg == vg && !strncmp(lvl->lv->lvid.s, lvid->s, sizeof(*lvid)))
+		return lvl;
+
 	dm_list_iterate_items(lvl, &vg->lvs)
-		if (!strncmp(lvl->lv->lvid.s, lvid->s, sizeof(*lvid)))
+		if (!strncmp(lvl->lv->lvid.s, lvid->s, sizeof(*lvid))) {
+			vg_index_rebuild(vg->lv_ids);
 			return lvl;
+		}
 
 	return NULL;
 }
@@ -2645,6 +2715,19 @@ int vg_write(struct volume_group *vg)
 		}
 	}
 
+	if (vg->fid->fmt->ops->vg_write_flush &&
+	    !vg->fid->fmt->ops->vg_write_flush(vg->fid, vg)) {
+		stack;
+		/* Revert */
+		dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
+			if (mda->ops->vg_revert &&
+			    !mda->ops->vg_revert(vg->fid, vg, mda)) {
+				stack;
+			}
+		}
+		return 0;
+	}
+
 	/* Now pre-commit each copy of the new metadata */
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		if (mda->ops->vg_precommit &&
@@ -2827,6 +2910,9 @@ static struct volume_group *_vg_read_orphans(struct cmd_context *cmd,
 	if (!lvmcache_foreach_pv(vginfo, _vg_read_orphan_pv, &baton))
 		return_NULL;
 
+	/* Drop index entries of the PVs read last time */
+	vg_index_rebuild(vg->pv_ids);
+
 	return vg;
 }
 
@@ -2943,8 +3029,9 @@ static struct volume_group *_vg_read(struct cmd_context *cmd,
 	struct format_instance_ctx fic;
 	const struct format_type *fmt;
 	struct volume_group *vg, *correct_vg = NULL;
-	struct metadata_area *mda;
+	struct metadata_area *mda, *correct_mda = NULL;
 	struct lvmcache_info *info;
+	uint32_t checksum, size, correct_checksum = 0, correct_size = 0;
 	int inconsistent = 0;
 	int inconsistent_vgid = 0;
 	int inconsistent_pvs = 0;
@@ -3036,6 +3123,21 @@ static struct volume_group *_vg_read(struct cmd_context *cmd,
 	inconsistent_mda_count=0;
 	dm_list_iterate_items(mda, &fid->metadata_areas_in_use) {
 
+		/* Don't import another copy of the text correct_vg came from */
+		if (correct_mda && !use_precommitted &&
+		    mda->ops->vg_read_checksum && correct_mda->ops->vg_read_checksum) {
+			if (!correct_size &&
+			    !correct_mda->ops->vg_read_checksum(fid, vgname, correct_mda,
+								&correct_checksum, &correct_size))
+				correct_mda = NULL;
+			else if (mda->ops->vg_read_checksum(fid, vgname, mda, &checksum, &size) &&
+				 checksum == correct_checksum && size == correct_size) {
+				log_debug_metadata("Skipping import of identical metadata "
+						   "for VG %s.", vgname);
+				continue;
+			}
+		}
+
 		if ((use_precommitted &&
 		     !(vg = mda->ops->vg_read_precommit(fid, vgname, mda))) ||
 		    (!use_precommitted &&
@@ -3046,6 +3148,7 @@ static struct volume_group *_vg_read(struct cmd_context *cmd,
 
 		if (!correct_vg) {
 			correct_vg = vg;
+			correct_mda = mda;
 			continue;
 		}
 
@@ -3061,6 +3164,8 @@ static struct volume_group *_vg_read(struct cmd_context *cmd,
 			if (vg->seqno > correct_vg->seqno) {
 				release_vg(correct_vg);
 				correct_vg = vg;
+				correct_mda = mda;
+				correct_size = 0;
 			} else {
 				mda->status |= MDA_INCONSISTENT;
 				++inconsistent_mda_count;
@@ -4164,6 +4269,17 @@ static struct volume_group *_vg_lock_and_read(struct cmd_context *cmd, const cha
 	if (failure)
 		goto_bad;
 
+	/*
+	 * Without the write lock the VG is never written, so it is its own
+	 * on-disk copy (see lv_ondisk()) and vg_ondisk is not built.
+	 */
+	if (lock_flags != LCK_VG_WRITE && !vg->vg_ondisk) {
+		/* Cached VG may have its pool locked: only write if needed */
+		if (vg->read_status != SUCCESS)
+			vg->read_status = SUCCESS;
+		return vg;
+	}
+
 	return _vg_make_handle(cmd, vg, failure);
 
 bad:
@@ -81,6 +81,14 @@ struct metadata_area_ops {
 	struct volume_group *(*vg_read_precommit) (struct format_instance * fi,
 					 const char *vg_name,
 					 struct metadata_area * mda);
+	/*
+	 * Read and verify the VG metadata text without importing it.
+	 * Returns the checksum and size of the text.
+	 */
+	int (*vg_read_checksum) (struct format_instance * fi,
+				 const char *vg_name,
+				 struct metadata_area * mda,
+				 uint32_t *checksum, uint32_t *size);
 	/*
 	 * Write out complete VG metadata.  You must ensure internal
 	 * consistency before calling. eg. PEs can't refer to PVs not
@@ -203,11 +211,11 @@ struct metadata_area *fid_get_mda_indexed(struct format_instance *fid,
 		const char *key, size_t key_len, const unsigned sub_key);
 int mdas_empty_or_ignored(struct dm_list *mdas);
 
-#define seg_pvseg(seg, s)	(seg)->areas[(s)].u.pv.pvseg
-#define seg_dev(seg, s)		(seg)->areas[(s)].u.pv.pvseg->pv->dev
-#define seg_pe(seg, s)		(seg)->areas[(s)].u.pv.pvseg->pe
-#define seg_le(seg, s)		(seg)->areas[(s)].u.lv.le
-#define seg_metale(seg, s)	(seg)->meta_areas[(s)].u.lv.le
+#define seg_pvseg(seg, s)	(seg)->areas[(s)].u.pvseg
+#define seg_dev(seg, s)		(seg)->areas[(s)].u.pvseg->pv->dev
+#define seg_pe(seg, s)		(seg)->areas[(s)].u.pvseg->pe
+#define seg_le(seg, s)		(seg)->areas[(s)].le
+#define seg_metale(seg, s)	(seg)->meta_areas[(s)].le
 
 struct name_list {
 	struct dm_list list;
@@ -308,6 +316,12 @@ struct format_handler {
 	 */
 	int (*vg_setup) (struct format_instance * fi, struct volume_group * vg);
 
+	/*
+	 * Complete the writes the metadata areas queued in vg_write.
+	 */
+	int (*vg_write_flush) (struct format_instance * fi,
+			       struct volume_group * vg);
+
 	/*
 	 * Check whether particular segment type is supported.
 	 */
@@ -412,6 +426,7 @@ int check_replicator_segment(const struct lv_segment *replicator_seg);
  * to merge as many segments as possible.
  */
 int lv_merge_segments(struct logical_volume *lv);
+int lv_segments_compatible(struct lv_segment *first, struct lv_segment *second);
 
 /*
  * Ensure there's a segment boundary at a given LE, splitting if necessary
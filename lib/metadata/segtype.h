@@ -95,6 +95,8 @@ struct segtype_handler {
 			    struct dm_hash_table * pv_hash);
 	int (*merge_segments) (struct lv_segment * seg1,
 			       struct lv_segment * seg2);
+	int (*segments_compatible) (struct lv_segment * seg1,
+				    struct lv_segment * seg2);
 	int (*add_target_line) (struct dev_manager *dm, struct dm_pool *mem,
 				struct cmd_context *cmd, void **target_state,
 				struct lv_segment *seg,
@@ -19,6 +19,151 @@
 #include "activate.h"
 #include "toolcontext.h"
 #include "lvmcache.h"
+#include "segtype.h"
+#include "str_list.h"
+
+/*
+ * Hash index over the items of vg->lvs or vg->pvs.  Names and uuids
+ * may change without the index being told, so callers verify each hit
+ * and rebuild the index when a lookup finds it out of date.
+ *
+ * The index lives outside the VG pool: a cached VG from lvmcache has
+ * its pool locked and checksummed, yet its lookups still rebuild.
+ */
+struct vg_index {
+	struct dm_list *items;
+	vg_index_key_fn key;
+	struct dm_hash_table *table;
+	unsigned size;
+	unsigned entries;
+};
+
+#define VG_INDEX_MIN_SIZE 64
+
+static const void *_lv_name_key(struct dm_list *item, unsigned *len)
+{
+	const char *name = dm_list_item(item, struct lv_list)->lv->name;
+
+	*len = strlen(name) + 1;
+
+	return name;
+}
+
+static const void *_lv_id_key(struct dm_list *item, unsigned *len)
+{
+	*len = sizeof(struct id) * 2;
+
+	return dm_list_item(item, struct lv_list)->lv->lvid.id;
+}
+
+static const void *_pv_id_key(struct dm_list *item, unsigned *len)
+{
+	*len = sizeof(struct id);
+
+	return &dm_list_item(item, struct pv_list)->pv->id;
+}
+
+static struct vg_index *_vg_index_create(struct dm_list *items,
+					 vg_index_key_fn key)
+{
+	struct vg_index *ix;
+
+	if (!(ix = dm_zalloc(sizeof(*ix))))
+		return_NULL;
+
+	ix->items = items;
+	ix->key = key;
+
+	return ix;
+}
+
+static void _vg_index_destroy(struct vg_index *ix)
+{
+	if (ix && ix->table)
+		dm_hash_destroy(ix->table);
+}
+
+static void _vg_index_free(struct vg_index *ix)
+{
+	_vg_index_destroy(ix);
+	dm_free(ix);
+}
+
+void vg_index_rebuild(struct vg_index *ix)
+{
+	struct dm_list *item;
+	const void *key;
+	unsigned len, size = VG_INDEX_MIN_SIZE;
+
+	_vg_index_destroy(ix);
+	ix->table = NULL;
+	ix->entries = 0;
+
+	while (size < 2 * dm_list_size(ix->items))
+		size *= 2;
+
+	if (!(ix->table = dm_hash_create(size))) {
+		log_debug_metadata("Failed to allocate VG index.");
+		return;
+	}
+	ix->size = size;
+
+	dm_list_iterate(item, ix->items) {
+		key = ix->key(item, &len);
+		if (!dm_hash_lookup_binary(ix->table, key, len))
+			ix->entries++;
+		if (!dm_hash_insert_binary(ix->table, key, len, item)) {
+			dm_hash_destroy(ix->table);
+			ix->table = NULL;
+			return;
+		}
+	}
+}
+
+void vg_index_add(struct vg_index *ix, struct dm_list *item)
+{
+	const void *key;
+	unsigned len;
+
+	if (!ix->table)
+		return;		/* Built on first lookup */
+
+	if (ix->entries >= ix->size) {
+		vg_index_rebuild(ix);
+		return;
+	}
+
+	key = ix->key(item, &len);
+	if (!dm_hash_lookup_binary(ix->table, key, len))
+		ix->entries++;
+	if (!dm_hash_insert_binary(ix->table, key, len, item))
+		vg_index_rebuild(ix);
+}
+
+void vg_index_del(struct vg_index *ix, struct dm_list *item)
+{
+	const void *key;
+	unsigned len;
+
+	if (!ix->table)
+		return;
+
+	key = ix->key(item, &len);
+	if (dm_hash_lookup_binary(ix->table, key, len) == item) {
+		dm_hash_remove_binary(ix->table, key, len);
+		ix->entries--;
+	}
+}
+
+/* Returns a list item that must be verified by the caller */
+struct dm_list *vg_index_lookup(const struct vg_index *ix,
+				const void *key, unsigned len)
+{
+	if (!ix->table)
+		return NULL;
+
+	return dm_hash_lookup_binary(ix->table, key, len);
+}
 
 struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 			      const char *vg_name)
@@ -50,6 +195,17 @@ struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 		return NULL;
 	}
 
+	if (!(vg->lv_names = _vg_index_create(&vg->lvs, _lv_name_key)) ||
+	    !(vg->lv_ids = _vg_index_create(&vg->lvs, _lv_id_key)) ||
+	    !(vg->pv_ids = _vg_index_create(&vg->pvs, _pv_id_key))) {
+		log_error("Failed to allocate VG indexes.");
+		dm_free(vg->lv_names);
+		dm_free(vg->lv_ids);
+		dm_hash_destroy(vg->hostnames);
+		dm_pool_destroy(vgmem);
+		return NULL;
+	}
+
 	dm_list_init(&vg->pvs);
 	dm_list_init(&vg->pvs_to_create);
 	dm_list_init(&vg->lvs);
@@ -74,6 +230,9 @@ static void _free_vg(struct volume_group *vg)
 	log_debug_mem("Freeing VG %s at %p.", vg->name, vg);
 
 	dm_hash_destroy(vg->hostnames);
+	_vg_index_free(vg->lv_names);
+	_vg_index_free(vg->lv_ids);
+	_vg_index_free(vg->pv_ids);
 	dm_pool_destroy(vg->vgmem);
 }
 
@@ -103,6 +262,345 @@ void free_orphan_vg(struct volume_group *vg)
 	_free_vg(vg);
 }
 
+/*
+ * Direct deep copy of a VG, used instead of an export/import round
+ * trip to create vg_ondisk.  Old pointers are translated through a
+ * hash; any reference to an object outside the VG aborts the copy.
+ */
+struct vg_copy {
+	struct volume_group *vg;
+	struct dm_hash_table *map;
+	int failed;
+};
+
+static int _copy_map(struct vg_copy *vc, const void *old, void *new)
+{
+	if (!dm_hash_insert_binary(vc->map, &old, sizeof(old), new)) {
+		log_error("Failed to map copied VG object.");
+		return 0;
+	}
+
+	return 1;
+}
+
+static void *_copy_remap(struct vg_copy *vc, const void *old)
+{
+	void *new;
+
+	if (!old)
+		return NULL;
+
+	if (!(new = dm_hash_lookup_binary(vc->map, &old, sizeof(old))))
+		vc->failed = 1;
+
+	return new;
+}
+
+/* Returns number of objects to copy, or 0 if the VG can't be copied */
+static unsigned _vg_copy_size(struct volume_group *vg)
+{
+	struct lv_list *lvl;
+	struct pv_list *pvl;
+	struct lv_segment *seg;
+	unsigned count = 0;
+
+	dm_list_iterate_items(lvl, &vg->lvs) {
+		if (lvl->lv->rdevice || !dm_list_empty(&lvl->lv->rsites))
+			return 0;
+
+		dm_list_iterate_items(seg, &lvl->lv->segments) {
+			if (seg->segtype_private ||
+			    (seg->segtype->flags & (SEG_UNKNOWN | SEG_REPLICATOR |
+						    SEG_REPLICATOR_DEV)))
+				return 0;
+			count++;
+		}
+		count++;
+	}
+
+	dm_list_iterate_items(pvl, &vg->pvs)
+		count += dm_list_size(&pvl->pv->segments);
+
+	return count ? : 1;
+}
+
+static int _copy_pv(struct vg_copy *vc, struct physical_volume *old)
+{
+	struct dm_pool *mem = vc->vg->vgmem;
+	struct pv_list *pvl;
+	struct physical_volume *pv;
+	struct pv_segment *oldseg, *pvseg;
+
+	if (!(pvl = dm_pool_zalloc(mem, sizeof(*pvl))) ||
+	    !(pvl->pv = pv = dm_pool_alloc(mem, sizeof(*pv))))
+		return_0;
+
+	*pv = *old;
+	pv->fid = NULL;
+	pv->vg = NULL;
+	pv->status &= ~UNLABELLED_PV;
+	memset(&pv->old_id, 0, sizeof(pv->old_id));
+
+	if (old->vg_name && !(pv->vg_name = dm_pool_strdup(mem, old->vg_name)))
+		return_0;
+
+	if (!str_list_dup(mem, &pv->tags, &old->tags))
+		return_0;
+
+	dm_list_init(&pv->segments);
+	dm_list_iterate_items(oldseg, &old->segments) {
+		if (!(pvseg = dm_pool_alloc(mem, sizeof(*pvseg))))
+			return_0;
+
+		*pvseg = *oldseg;
+		pvseg->pv = pv;
+		pvseg->lvseg = NULL;	/* Set when copying the LV segment */
+		dm_list_add(&pv->segments, &pvseg->list);
+
+		if (!_copy_map(vc, oldseg, pvseg))
+			return_0;
+	}
+
+	add_pvl_to_vgs(vc->vg, pvl);
+
+	return 1;
+}
+
+static int _copy_lv(struct vg_copy *vc, struct logical_volume *old)
+{
+	struct volume_group *vg = vc->vg;
+	struct logical_volume *lv;
+	const char *hn;
+
+	if (!(lv = alloc_lv(vg->vgmem)))
+		return_0;
+
+	lv->lvid = old->lvid;
+	lv->status = old->status & ~(PARTIAL_LV | POSTORDER_FLAG | POSTORDER_OPEN_FLAG);
+	lv->alloc = old->alloc;
+	lv->profile = old->profile;
+	lv->read_ahead = old->read_ahead;
+	lv->major = old->major;
+	lv->minor = old->minor;
+	lv->size = old->size;
+	lv->le_count = old->le_count;
+	lv->origin_count = old->origin_count;
+	lv->external_count = old->external_count;
+	lv->timestamp = old->timestamp;
+
+	if (!(lv->name = dm_pool_strdup(vg->vgmem, old->name)))
+		return_0;
+
+	if (old->hostname) {
+		if (!(hn = dm_hash_lookup(vg->hostnames, old->hostname))) {
+			if (!(hn = dm_pool_strdup(vg->vgmem, old->hostname)) ||
+			    !dm_hash_insert(vg->hostnames, hn, (void *) hn))
+				return_0;
+		}
+		lv->hostname = hn;
+	}
+
+	if (!str_list_dup(vg->vgmem, &lv->tags, &old->tags))
+		return_0;
+
+	if (!link_lv_to_vg(vg, lv))
+		return_0;
+
+	return _copy_map(vc, old, lv);
+}
+
+static int _copy_areas(struct vg_copy *vc, struct lv_segment *seg,
+		       struct lv_segment_area **areas,
+		       const struct lv_segment_area *old)
+{
+	struct pv_segment *pvseg;
+	uint32_t s;
+
+	if (!(*areas = dm_pool_alloc(vc->vg->vgmem, seg->area_count * sizeof(**areas))))
+		return_0;
+
+	for (s = 0; s < seg->area_count; s++) {
+		(*areas)[s] = old[s];
+
+		switch (old[s].type) {
+		case AREA_PV:
+			if ((pvseg = _copy_remap(vc, old[s].u.pvseg)))
+				pvseg->lvseg = seg;
+			(*areas)[s].u.pvseg = pvseg;
+			break;
+		case AREA_LV:
+			(*areas)[s].u.lv = _copy_remap(vc, old[s].u.lv);
+			break;
+		case AREA_UNASSIGNED:
+			break;
+		}
+	}
+
+	return 1;
+}
+
+static int _copy_lv_segment(struct vg_copy *vc, struct logical_volume *lv,
+			    struct lv_segment *old)
+{
+	struct dm_pool *mem = vc->vg->vgmem;
+	struct lv_segment *seg;
+	struct lv_thin_message *oldmsg, *tmsg;
+
+	if (!(seg = dm_pool_alloc(mem, sizeof(*seg))))
+		return_0;
+
+	*seg = *old;
+	seg->lv = lv;
+	seg->pvmove_source_seg = NULL;
+	dm_list_init(&seg->origin_list);
+
+	seg->origin = _copy_remap(vc, old->origin);
+	seg->cow = _copy_remap(vc, old->cow);
+	seg->log_lv = _copy_remap(vc, old->log_lv);
+	seg->metadata_lv = _copy_remap(vc, old->metadata_lv);
+	seg->external_lv = _copy_remap(vc, old->external_lv);
+	seg->pool_lv = _copy_remap(vc, old->pool_lv);
+
+	if (!str_list_dup(mem, &seg->tags, &old->tags))
+		return_0;
+
+	if (!_copy_areas(vc, seg, &seg->areas, old->areas))
+		return_0;
+
+	if (old->meta_areas &&
+	    !_copy_areas(vc, seg, &seg->meta_areas, old->meta_areas))
+		return_0;
+
+	dm_list_init(&seg->thin_messages);
+	dm_list_iterate_items(oldmsg, &old->thin_messages) {
+		if (!(tmsg = dm_pool_alloc(mem, sizeof(*tmsg))))
+			return_0;
+
+		*tmsg = *oldmsg;
+		if (oldmsg->type != DM_THIN_MESSAGE_DELETE)
+			tmsg->u.lv = _copy_remap(vc, oldmsg->u.lv);
+		dm_list_add(&seg->thin_messages, &tmsg->list);
+	}
+
+	dm_list_add(&lv->segments, &seg->list);
+
+	return _copy_map(vc, old, seg);
+}
+
+static int _copy_lv_users(struct vg_copy *vc, struct logical_volume *lv,
+			  struct logical_volume *old)
+{
+	struct seg_list *oldsl, *sl;
+	struct lv_segment *oldseg, *seg;
+
+	lv->snapshot = _copy_remap(vc, old->snapshot);
+
+	dm_list_iterate_items_gen(oldseg, &old->snapshot_segs, origin_list) {
+		if (!(seg = _copy_remap(vc, oldseg)))
+			continue;
+		dm_list_add(&lv->snapshot_segs, &seg->origin_list);
+	}
+
+	dm_list_iterate_items(oldsl, &old->segs_using_this_lv) {
+		if (!(sl = dm_pool_alloc(vc->vg->vgmem, sizeof(*sl))))
+			return_0;
+
+		sl->count = oldsl->count;
+		sl->seg = _copy_remap(vc, oldsl->seg);
+		dm_list_add(&lv->segs_using_this_lv, &sl->list);
+	}
+
+	return 1;
+}
+
+struct volume_group *vg_copy(struct volume_group *vg,
+			     struct format_instance *fid)
+{
+	struct vg_copy vc = { 0 };
+	struct volume_group *copy;
+	struct pv_list *pvl;
+	struct lv_list *lvl;
+	struct lv_segment *seg;
+	unsigned count;
+
+	if (!(count = _vg_copy_size(vg))) {
+		log_debug_metadata("VG %s has segments that need a text copy.",
+				   vg->name);
+		return NULL;
+	}
+
+	if (!(copy = alloc_vg("vg_copy", vg->cmd, vg->name)))
+		return_NULL;
+
+	vc.vg = copy;
+	if (!(vc.map = dm_hash_create(count))) {
+		log_error("Failed to allocate VG copy map.");
+		goto bad;
+	}
+
+	copy->seqno = vg->seqno;
+	copy->alloc = vg->alloc;
+	copy->profile = vg->profile;
+	copy->status = vg->status & ~(PARTIAL_VG | PRECOMMITTED | ARCHIVED_VG);
+	copy->id = vg->id;
+	copy->extent_size = vg->extent_size;
+	copy->extent_count = vg->extent_count;
+	copy->free_count = vg->free_count;
+	copy->max_lv = vg->max_lv;
+	copy->max_pv = vg->max_pv;
+	copy->mda_copies = vg->mda_copies;
+
+	if (!(copy->system_id = dm_pool_zalloc(copy->vgmem, NAME_LEN + 1)))
+		goto_bad;
+	if (vg->system_id)
+		strncpy(copy->system_id, vg->system_id, NAME_LEN);
+
+	if (!str_list_dup(copy->vgmem, &copy->tags, &vg->tags))
+		goto_bad;
+
+	dm_list_iterate_items(pvl, &vg->pvs)
+		if (!_copy_pv(&vc, pvl->pv))
+			goto_bad;
+
+	dm_list_iterate_items(lvl, &vg->lvs)
+		if (!_copy_lv(&vc, lvl->lv))
+			goto_bad;
+
+	/* Segments reference any LV, so all LVs must be mapped first */
+	dm_list_iterate_items(lvl, &vg->lvs)
+		dm_list_iterate_items(seg, &lvl->lv->segments)
+			if (!_copy_lv_segment(&vc, _copy_remap(&vc, lvl->lv), seg))
+				goto_bad;
+
+	dm_list_iterate_items(lvl, &vg->lvs)
+		if (!_copy_lv_users(&vc, _copy_remap(&vc, lvl->lv), lvl->lv))
+			goto_bad;
+
+	copy->pool_metadata_spare_lv = _copy_remap(&vc, vg->pool_metadata_spare_lv);
+
+	if (vc.failed) {
+		log_debug_metadata("VG %s references objects outside itself, "
+				   "using a text copy.", vg->name);
+		goto bad;
+	}
+
+	dm_hash_destroy(vc.map);
+
+	vg_set_fid(copy, fid);
+
+	if (vg_missing_pv_count(copy))
+		vg_mark_partial_lvs(copy, 1);
+
+	return copy;
+
+bad:
+	if (vc.map)
+		dm_hash_destroy(vc.map);
+	release_vg(copy);
+
+	return NULL;
+}
+
 char *vg_fmt_dup(const struct volume_group *vg)
 {
 	if (!vg->fid || !vg->fid->fmt)
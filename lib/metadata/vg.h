@@ -21,6 +21,7 @@ struct format_instance;
 struct dm_list;
 struct id;
 struct logical_volume;
+struct vg_index;
 
 typedef enum {
 	ALLOC_INVALID,
@@ -122,12 +123,28 @@ struct volume_group {
 	uint32_t mda_copies; /* target number of mdas for this VG */
 
 	struct dm_hash_table *hostnames; /* map of creation hostnames */
+
+	/* Lookup indexes used by find_lv_in_vg() and friends */
+	struct vg_index *lv_names;	/* LV name -> lv_list */
+	struct vg_index *lv_ids;	/* LV lvid -> lv_list */
+	struct vg_index *pv_ids;	/* PV uuid -> pv_list */
 	struct logical_volume *pool_metadata_spare_lv; /* one per VG */
 };
 
 struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 			      const char *vg_name);
 
+/*
+ * Maintain the lookup indexes of a VG.  Items are the list members of
+ * vg->lvs or vg->pvs; hits from vg_index_lookup() may be stale.
+ */
+typedef const void *(*vg_index_key_fn)(struct dm_list *item, unsigned *len);
+void vg_index_add(struct vg_index *ix, struct dm_list *item);
+void vg_index_del(struct vg_index *ix, struct dm_list *item);
+void vg_index_rebuild(struct vg_index *ix);
+struct dm_list *vg_index_lookup(const struct vg_index *ix,
+				const void *key, unsigned len);
+
 /*
  * release_vg() must be called on every struct volume_group allocated
  * by vg_create() or vg_read_internal() to free it when no longer required.
@@ -135,6 +152,13 @@ struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 void release_vg(struct volume_group *vg);
 void free_orphan_vg(struct volume_group *vg);
 
+/*
+ * Deep copy of a VG into its own pool, sharing fid.
+ * Returns NULL if the VG can only be copied through its text form.
+ */
+struct volume_group *vg_copy(struct volume_group *vg,
+			     struct format_instance *fid);
+
 char *vg_fmt_dup(const struct volume_group *vg);
 char *vg_name_dup(const struct volume_group *vg);
 char *vg_system_id_dup(const struct volume_group *vg);
@@ -44,6 +44,7 @@ static int _error_message_produced = 0;
 static unsigned _is_static = 0;
 static int _udev_checking = 1;
 static int _retry_deactivation = DEFAULT_RETRY_DEACTIVATION;
+static unsigned _parallel_workers = DEFAULT_PARALLEL_WORKERS;
 static int _activation_checks = 0;
 static char _sysfs_dir_path[PATH_MAX] = "";
 static int _dev_disable_after_error_count = DEFAULT_DISABLE_AFTER_ERROR_COUNT;
@@ -146,6 +147,11 @@ void init_retry_deactivation(int retry)
 	_retry_deactivation = retry;
 }
 
+void init_parallel_workers(unsigned workers)
+{
+	_parallel_workers = workers;
+}
+
 void init_activation_checks(int checks)
 {
 	if ((_activation_checks = checks))
@@ -308,6 +314,11 @@ int retry_deactivation(void)
 	return _retry_deactivation;
 }
 
+unsigned parallel_workers(void)
+{
+	return _parallel_workers;
+}
+
 int activation_checks(void)
 {
 	return _activation_checks;
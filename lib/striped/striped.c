@@ -214,6 +214,7 @@ static struct segtype_handler _striped_ops = {
 	.text_import = _striped_text_import,
 	.text_export = _striped_text_export,
 	.merge_segments = _striped_merge_segments,
+	.segments_compatible = _striped_segments_compatible,
 #ifdef DEVMAPPER_SUPPORT
 	.add_target_line = _striped_add_target_line,
 	.target_present = _striped_target_present,
@@ -54,6 +54,9 @@ static void _exit_handler(int sig __attribute__((unused)))
 
 #define EXIT_ALREADYRUNNING 13
 
+/* Released pool chunks each client thread keeps for its next request */
+#define CLIENT_THREAD_POOL_CACHE 8
+
 #ifdef linux
 
 #include <stddef.h>
@@ -383,6 +386,9 @@ static void *client_thread(void *baton)
 
 	buffer_init(&req.buffer);
 
+	/* Config trees for each request reuse this thread's chunks */
+	dm_pool_set_thread_cache(CLIENT_THREAD_POOL_CACHE);
+
 	while (1) {
 		if (!buffer_read(b->client.socket_fd, &req.buffer))
 			goto fail;
@@ -422,6 +428,7 @@ fail:
 		perror("close");
 	buffer_destroy(&req.buffer);
 	dm_free(baton);
+	dm_pool_set_thread_cache(0);
 	return NULL;
 }
 
@@ -1,6 +1,6 @@
 /*
  * Copyright (C) 2001-2004 Sistina Software, Inc. All rights reserved.  
- * Copyright (C) 2004-2006 Red Hat, Inc. All rights reserved.
+ * Copyright (C) 2004-2013 Red Hat, Inc. All rights reserved.
  *
  * This file is part of the device-mapper userspace tools.
  *
@@ -18,6 +18,19 @@
 /* FIXME: calculate this. */
 #define INT_SHIFT 5
 
+/* Index of the last word holding valid bits (words start at bs[1]) */
+#define _last_word(bs) (((bs)[0] + DM_BITS_PER_INT - 1) >> INT_SHIFT)
+
+#ifdef __GNUC__
+#  define _popcount32(w) ((unsigned) __builtin_popcount(w))
+#  define _popcount64(w) ((unsigned) __builtin_popcountll(w))
+#  define _ctz32(w) __builtin_ctz(w)
+#else
+#  define _popcount32(w) hweight32(w)
+#  define _popcount64(w) (hweight32((uint32_t) (w)) + hweight32((uint32_t) ((w) >> 32)))
+#  define _ctz32(w) (ffs(w) - 1)
+#endif
+
 dm_bitset_t dm_bitset_create(struct dm_pool *mem, unsigned num_bits)
 {
 	unsigned n = (num_bits / DM_BITS_PER_INT) + 2;
@@ -67,39 +80,118 @@ void dm_bit_union(dm_bitset_t out, dm_bitset_t in1, dm_bitset_t in2)
 		out[i] = in1[i] | in2[i];
 }
 
-static int _test_word(uint32_t test, int bit)
-{
-	uint32_t tb = test >> bit;
-
-	return (tb ? ffs(tb) + bit - 1 : -1);
-}
-
-int dm_bit_get_next(dm_bitset_t bs, int last_bit)
+/*
+ * Find the next bit after last_bit whose value differs from 'skip'
+ * (0 finds set bits, ~0 finds clear bits).
+ * Runs of words that are entirely 'skip' are passed over 64 bits at a time.
+ */
+static int _get_next(dm_bitset_t bs, int last_bit, uint32_t skip)
 {
-	int bit, word;
+	unsigned word, last_word = _last_word(bs);
+	uint64_t pair, skip64 = ((uint64_t) skip << 32) | skip;
 	uint32_t test;
+	int bit;
 
 	last_bit++;		/* otherwise we'll return the same bit again */
 
 	/*
 	 * bs[0] holds number of bits
 	 */
-	while (last_bit < (int) bs[0]) {
-		word = last_bit >> INT_SHIFT;
-		test = bs[word + 1];
-		bit = last_bit & (DM_BITS_PER_INT - 1);
-
-		if ((bit = _test_word(test, bit)) >= 0)
-			return (word * DM_BITS_PER_INT) + bit;
-
-		last_bit = last_bit - (last_bit & (DM_BITS_PER_INT - 1)) +
-		    DM_BITS_PER_INT;
+	if (last_bit < 0 || last_bit >= (int) bs[0])
+		return -1;
+
+	word = (last_bit >> INT_SHIFT) + 1;
+
+	/* Partial first word */
+	if ((test = (bs[word] ^ skip) >> (last_bit & (DM_BITS_PER_INT - 1))))
+		bit = last_bit + _ctz32(test);
+	else {
+		word++;
+		while (word < last_word) {
+			memcpy(&pair, bs + word, sizeof(pair));
+			if (pair != skip64)
+				break;
+			word += 2;
+		}
+
+		for (; word <= last_word; word++)
+			if ((test = bs[word] ^ skip))
+				break;
+
+		if (word > last_word)
+			return -1;
+
+		bit = ((word - 1) << INT_SHIFT) + _ctz32(test);
 	}
 
-	return -1;
+	return (bit < (int) bs[0]) ? bit : -1;
+}
+
+int dm_bit_get_next(dm_bitset_t bs, int last_bit)
+{
+	return _get_next(bs, last_bit, 0);
 }
 
 int dm_bit_get_first(dm_bitset_t bs)
 {
 	return dm_bit_get_next(bs, -1);
 }
+
+int dm_bit_get_next_zero(dm_bitset_t bs, int last_bit)
+{
+	return _get_next(bs, last_bit, ~UINT32_C(0));
+}
+
+int dm_bit_get_first_zero(dm_bitset_t bs)
+{
+	return dm_bit_get_next_zero(bs, -1);
+}
+
+unsigned dm_bit_count(dm_bitset_t bs)
+{
+	unsigned word = 1, full_words = bs[0] >> INT_SHIFT;
+	unsigned tail = bs[0] & (DM_BITS_PER_INT - 1);
+	unsigned count = 0;
+	uint64_t pair;
+
+	for (; word + 1 <= full_words; word += 2) {
+		memcpy(&pair, bs + word, sizeof(pair));
+		count += _popcount64(pair);
+	}
+
+	if (word <= full_words)
+		count += _popcount32(bs[word++]);
+
+	/* Ignore any bits beyond the end, e.g. after dm_bit_set_all() */
+	if (tail)
+		count += _popcount32(bs[word] & ((UINT32_C(1) << tail) - 1));
+
+	return count;
+}
+
+void dm_bit_range_set(dm_bitset_t bs, unsigned first_bit, unsigned last_bit)
+{
+	unsigned first_word, last_word;
+	uint32_t first_mask, last_mask;
+
+	if (first_bit > last_bit || first_bit >= bs[0])
+		return;
+
+	if (last_bit >= bs[0])
+		last_bit = bs[0] - 1;
+
+	first_word = (first_bit >> INT_SHIFT) + 1;
+	last_word = (last_bit >> INT_SHIFT) + 1;
+	first_mask = ~UINT32_C(0) << (first_bit & (DM_BITS_PER_INT - 1));
+	last_mask = ~UINT32_C(0) >> (DM_BITS_PER_INT - 1 - (last_bit & (DM_BITS_PER_INT - 1)));
+
+	if (first_word == last_word) {
+		bs[first_word] |= first_mask & last_mask;
+		return;
+	}
+
+	bs[first_word] |= first_mask;
+	if (last_word > first_word + 1)
+		memset(bs + first_word + 1, -1, (last_word - first_word - 1) * sizeof(*bs));
+	bs[last_word] |= last_mask;
+}
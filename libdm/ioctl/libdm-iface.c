@@ -85,7 +85,6 @@ static uint32_t _dm_device_major = 0;
 static int _control_fd = -1;
 static int _version_checked = 0;
 static int _version_ok = 1;
-static unsigned _ioctl_buffer_double_factor = 0;
 
 const int _dm_compat = 0;
 
@@ -119,6 +118,29 @@ static struct cmd_data _cmd_data_v4[] = {
 };
 /* *INDENT-ON* */
 
+/*
+ * How many times the ioctl buffer had to be doubled for each task type.
+ * Kept per type so e.g. a large 'names' list does not inflate every
+ * following 'info' buffer and a large 'table' is not re-grown each time.
+ */
+static unsigned _ioctl_buffer_double_factor[DM_ARRAY_SIZE(_cmd_data_v4)];
+
+/* dmeventd threads run tasks concurrently, so access them atomically */
+static unsigned _get_buffer_double_factor(int type)
+{
+	return __sync_fetch_and_add(&_ioctl_buffer_double_factor[type], 0);
+}
+
+/*
+ * Grow the hint after an ioctl run with 'used' did not fit.
+ * Threads racing on the same full buffer grow it only once.
+ */
+static void _grow_buffer_double_factor(int type, unsigned used)
+{
+	(void) __sync_bool_compare_and_swap(&_ioctl_buffer_double_factor[type],
+					    used, used + 1);
+}
+
 #define ALIGNMENT 8
 
 /* FIXME Rejig library to record & use errno instead */
@@ -126,6 +148,40 @@ static struct cmd_data _cmd_data_v4[] = {
 #  define DM_EXISTS_FLAG 0x00000004
 #endif
 
+/*
+ * Ioctl buffer shared by several tasks, so each of them need not
+ * allocate and clear its own (at least 16KiB) buffer.
+ */
+struct ioctl_buffer {
+	struct dm_ioctl *dmi;
+	size_t size;
+};
+
+struct dm_task_batch {
+	struct dm_task **tasks;
+	unsigned count;
+	unsigned allocated;
+	struct ioctl_buffer buffer;
+};
+
+/*
+ * Buffer reused by dm_task_run() for queries.  A thread finding it busy
+ * (dmeventd runs tasks from many threads) allocates its own instead.
+ */
+static struct ioctl_buffer _ioctl_buffer;
+static int _ioctl_buffer_busy = 0;
+
+static struct ioctl_buffer *_ioctl_buffer_claim(void)
+{
+	return __sync_lock_test_and_set(&_ioctl_buffer_busy, 1) ? NULL : &_ioctl_buffer;
+}
+
+static void _ioctl_buffer_unclaim(struct ioctl_buffer *buf)
+{
+	if (buf)
+		__sync_lock_release(&_ioctl_buffer_busy);
+}
+
 static char *_align(char *ptr, unsigned int a)
 {
 	register unsigned long agn = --a;
@@ -977,7 +1033,44 @@ static int _lookup_dev_name(uint64_t dev, char *buf, size_t len)
 	return r;
 }
 
-static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
+static void _ioctl_buffer_release(struct ioctl_buffer *buf)
+{
+	if (buf->dmi) {
+		memset(buf->dmi, 0, buf->size);
+		dm_free(buf->dmi);
+	}
+
+	buf->dmi = NULL;
+	buf->size = 0;
+}
+
+/*
+ * Returns dmi of at least len bytes from buf, growing it if needed.
+ * Only the first used_len bytes are cleared, the rest is output space.
+ */
+static struct dm_ioctl *_ioctl_buffer_get(struct ioctl_buffer *buf,
+					  size_t len, size_t used_len)
+{
+	if (buf->size < len) {
+		_ioctl_buffer_release(buf);
+
+		if (!(buf->dmi = dm_malloc(len)))
+			return_NULL;
+
+		buf->size = len;
+	}
+
+	memset(buf->dmi, 0, used_len);
+
+	return buf->dmi;
+}
+
+/*
+ * Build the ioctl argument for dmt.  If buf is supplied, the returned
+ * dmi lives in that shared buffer and must not be freed by the caller.
+ */
+static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count,
+				 struct ioctl_buffer *buf)
 {
 	const size_t min_size = 16 * 1024;
 	const int (*version)[3];
@@ -986,6 +1079,7 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 	struct target *t;
 	struct dm_target_msg *tmsg;
 	size_t len = sizeof(struct dm_ioctl);
+	size_t used_len;
 	char *b, *e;
 	int count = 0;
 
@@ -1039,6 +1133,8 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 	if (dmt->geometry)
 		len += strlen(dmt->geometry) + 1;
 
+	used_len = len;
+
 	/*
 	 * Give len a minimum size so that we have space to store
 	 * dependencies or status information.
@@ -1050,10 +1146,15 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 	while (repeat_count--)
 		len *= 2;
 
-	if (!(dmi = dm_malloc(len)))
-		return NULL;
+	if (buf) {
+		if (!(dmi = _ioctl_buffer_get(buf, len, used_len)))
+			return NULL;
+	} else {
+		if (!(dmi = dm_malloc(len)))
+			return NULL;
 
-	memset(dmi, 0, len);
+		memset(dmi, 0, len);
+	}
 
 	version = &_cmd_data_v4[dmt->type].version;
 
@@ -1156,7 +1257,8 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 	return dmi;
 
       bad:
-	_dm_zfree_dmi(dmi);
+	if (!buf)
+		_dm_zfree_dmi(dmi);
 	return NULL;
 }
 
@@ -1635,12 +1737,13 @@ static int _dm_ioctl_unmangle_uuids(int type, struct dm_ioctl *dmi)
 static struct dm_ioctl *_do_dm_ioctl(struct dm_task *dmt, unsigned command,
 				     unsigned buffer_repeat_count,
 				     unsigned retry_repeat_count,
-				     int *retryable)
+				     int *retryable,
+				     struct ioctl_buffer *buf)
 {
 	struct dm_ioctl *dmi;
 	int ioctl_with_uevent;
 
-	dmi = _flatten(dmt, buffer_repeat_count);
+	dmi = _flatten(dmt, buffer_repeat_count, buf);
 	if (!dmi) {
 		log_error("Couldn't create ioctl argument.");
 		return NULL;
@@ -1771,10 +1874,57 @@ static struct dm_ioctl *_do_dm_ioctl(struct dm_task *dmt, unsigned command,
 	return dmi;
 
 error:
-	_dm_zfree_dmi(dmi);
+	if (!buf)
+		_dm_zfree_dmi(dmi);
 	return NULL;
 }
 
+/* Read-only tasks whose results can be copied out of a shared buffer */
+static int _is_query(struct dm_task *dmt)
+{
+	switch (dmt->type) {
+	case DM_DEVICE_INFO:
+	case DM_DEVICE_DEPS:
+	case DM_DEVICE_STATUS:
+	case DM_DEVICE_TABLE:
+		return !dmt->head && !dmt->message && !dmt->newname &&
+			!dmt->geometry && !dmt->secure_data;
+	}
+
+	return 0;
+}
+
+/*
+ * Copy the result of a query out of the shared buffer.
+ * Queries without payload only need the dm_ioctl header.
+ */
+static struct dm_ioctl *_copy_dmi(struct dm_task *dmt, const struct dm_ioctl *dmi,
+				  size_t buffer_size)
+{
+	struct dm_ioctl *copy;
+	size_t len = dmi->data_start;
+
+	if ((dmi->flags & DM_EXISTS_FLAG) && dmt->type != DM_DEVICE_INFO)
+		len = dmi->data_size;
+
+	if (len < sizeof(*dmi) || len > buffer_size) {
+		log_error(INTERNAL_ERROR "Invalid %s ioctl result size %" PRIsize_t ".",
+			  _cmd_data_v4[dmt->type].name, len);
+		return NULL;
+	}
+
+	if (!(copy = dm_malloc(len))) {
+		log_error("Failed to allocate %s ioctl result.",
+			  _cmd_data_v4[dmt->type].name);
+		return NULL;
+	}
+
+	memcpy(copy, dmi, len);
+	copy->data_size = len;
+
+	return copy;
+}
+
 void dm_task_update_nodes(void)
 {
 	update_devs();
@@ -1786,11 +1936,13 @@ void dm_task_update_nodes(void)
 int dm_task_run(struct dm_task *dmt)
 {
 	struct dm_ioctl *dmi;
+	struct ioctl_buffer *buf = NULL;
 	unsigned command;
 	int check_udev;
 	int rely_on_udev;
 	int suspended_counter;
 	unsigned ioctl_retry = 1;
+	unsigned double_factor;
 	int retryable = 0;
 	const char *dev_name = DEV_NAME(dmt);
 	const char *dev_uuid = DEV_UUID(dmt);
@@ -1839,10 +1991,14 @@ int dm_task_run(struct dm_task *dmt)
 			  dmt->major > 0 && dmt->minor == 0 ? "0" : "",
 			  dmt->major > 0 ? ") " : "");
 
+	if (_is_query(dmt))
+		buf = _ioctl_buffer_claim();
+
 	/* FIXME Detect and warn if cookie set but should not be. */
 repeat_ioctl:
-	if (!(dmi = _do_dm_ioctl(dmt, command, _ioctl_buffer_double_factor,
-				 ioctl_retry, &retryable))) {
+	double_factor = _get_buffer_double_factor(dmt->type);
+	if (!(dmi = _do_dm_ioctl(dmt, command, double_factor,
+				 ioctl_retry, &retryable, buf))) {
 		/*
 		 * Async udev rules that scan devices commonly cause transient
 		 * failures.  Normally you'd expect the user to have made sure
@@ -1855,6 +2011,7 @@ repeat_ioctl:
 			goto repeat_ioctl;
 		}
 
+		_ioctl_buffer_unclaim(buf);
 		_udev_complete(dmt);
 		return 0;
 	}
@@ -1867,14 +2024,22 @@ repeat_ioctl:
 		case DM_DEVICE_STATUS:
 		case DM_DEVICE_TABLE:
 		case DM_DEVICE_WAITEVENT:
-			_ioctl_buffer_double_factor++;
-			_dm_zfree_dmi(dmi);
+			_grow_buffer_double_factor(dmt->type, double_factor);
+			if (!buf)
+				_dm_zfree_dmi(dmi);
 			goto repeat_ioctl;
 		default:
 			log_error("WARNING: libdevmapper buffer too small for data");
 		}
 	}
 
+	if (buf) {
+		dmi = _copy_dmi(dmt, dmi, buf->size);
+		_ioctl_buffer_unclaim(buf);
+		if (!dmi)
+			return_0;
+	}
+
 	/*
 	 * Are we expecting a udev operation to occur that we need to check for?
 	 */
@@ -1945,8 +2110,116 @@ repeat_ioctl:
 	return 0;
 }
 
+/*
+ * Task batches.
+ *
+ * Ioctls on the control device are synchronous, so tasks in a batch
+ * still run one after another.  They share a single ioctl buffer and
+ * only the part of the result each task needs is copied out of it.
+ */
+struct dm_task_batch *dm_task_batch_create(void)
+{
+	struct dm_task_batch *batch;
+
+	if (!(batch = dm_zalloc(sizeof(*batch)))) {
+		log_error("Failed to allocate task batch.");
+		return NULL;
+	}
+
+	return batch;
+}
+
+void dm_task_batch_destroy(struct dm_task_batch *batch)
+{
+	_ioctl_buffer_release(&batch->buffer);
+	dm_free(batch->tasks);
+	dm_free(batch);
+}
+
+int dm_task_batch_add(struct dm_task_batch *batch, struct dm_task *dmt)
+{
+	struct dm_task **tasks;
+	unsigned allocated;
+
+	if (!_is_query(dmt)) {
+		log_error(INTERNAL_ERROR "Task type %s can't be batched.",
+			  _cmd_data_v4[dmt->type].name);
+		return 0;
+	}
+
+	if (batch->count == batch->allocated) {
+		allocated = batch->allocated ? batch->allocated * 2 : 16;
+		if (!(tasks = dm_realloc(batch->tasks, allocated * sizeof(*tasks)))) {
+			log_error("Failed to grow task batch.");
+			return 0;
+		}
+		batch->tasks = tasks;
+		batch->allocated = allocated;
+	}
+
+	batch->tasks[batch->count++] = dmt;
+
+	return 1;
+}
+
+int dm_task_batch_run(struct dm_task_batch *batch)
+{
+	struct dm_task *dmt;
+	struct dm_ioctl *dmi;
+	unsigned i, double_factor;
+	int retryable = 0;
+	int r = 1;
+
+	if (!batch->count)
+		return 1;
+
+	if (!_open_control())
+		return_0;
+
+	for (i = 0; i < batch->count; i++) {
+		dmt = batch->tasks[i];
+repeat_ioctl:
+		double_factor = _get_buffer_double_factor(dmt->type);
+		if (!(dmi = _do_dm_ioctl(dmt, _cmd_data_v4[dmt->type].cmd,
+					 double_factor, 1,
+					 &retryable, &batch->buffer))) {
+			r = 0;
+			continue;
+		}
+
+		if (dmi->flags & DM_BUFFER_FULL_FLAG) {
+			_grow_buffer_double_factor(dmt->type, double_factor);
+			goto repeat_ioctl;
+		}
+
+		if (!(dmi = _copy_dmi(dmt, dmi, batch->buffer.size))) {
+			r = 0;
+			continue;
+		}
+
+		if ((dmt->type == DM_DEVICE_STATUS || dmt->type == DM_DEVICE_TABLE) &&
+		    !_unmarshal_status(dmt, dmi)) {
+			_dm_zfree_dmi(dmi);
+			r = 0;
+			continue;
+		}
+
+		_dm_zfree_dmi(dmt->dmi.v4);
+		dmt->dmi.v4 = dmi;
+	}
+
+	return r;
+}
+
 void dm_lib_release(void)
 {
+	struct ioctl_buffer *buf;
+
+	if ((buf = _ioctl_buffer_claim())) {
+		_ioctl_buffer_release(buf);
+		_ioctl_buffer_unclaim(buf);
+	}
+
 	_close_control_fd();
 	update_devs();
 }
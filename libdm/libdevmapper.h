@@ -349,6 +349,19 @@ int dm_get_status_thin(struct dm_pool *mem, const char *params,
  */
 int dm_task_run(struct dm_task *dmt);
 
+/*
+ * Run many independent DM_DEVICE_INFO, DM_DEVICE_DEPS, DM_DEVICE_STATUS
+ * or DM_DEVICE_TABLE tasks through one shared ioctl buffer.
+ * Tasks remain owned by the caller and are queried as after dm_task_run.
+ * dm_task_batch_run returns 0 if any task failed; a failed task has
+ * no result, so dm_task_get_info() on it returns 0.
+ */
+struct dm_task_batch;
+struct dm_task_batch *dm_task_batch_create(void);
+int dm_task_batch_add(struct dm_task_batch *batch, struct dm_task *dmt);
+int dm_task_batch_run(struct dm_task_batch *batch);
+void dm_task_batch_destroy(struct dm_task_batch *batch);
+
 /*
  * Call this to make or remove the device nodes associated with previously
  * issued commands.
@@ -605,6 +618,12 @@ void dm_tree_use_no_flush_suspend(struct dm_tree_node *dnode);
  */
 void dm_tree_retry_remove(struct dm_tree_node *dnode);
 
+/*
+ * Load tables of independent devices in up to max_threads threads
+ * during dm_tree_preload_children.  0 or 1 keeps everything serial.
+ */
+void dm_tree_set_parallel(struct dm_tree_node *dnode, unsigned max_threads);
+
 /*
  * Is the uuid prefix present in the tree?
  * Only returns 0 if every node was checked successfully.
@@ -940,6 +959,25 @@ void *dm_pool_alloc_aligned(struct dm_pool *p, size_t s, unsigned alignment)
 void dm_pool_empty(struct dm_pool *p);
 void dm_pool_free(struct dm_pool *p, void *ptr);
 
+/*
+ * Multithreaded daemons creating and destroying short-lived pools
+ * may let each thread keep up to max_chunks released chunks in a
+ * thread-local free list, so new pools reuse them instead of
+ * calling malloc.  Caching is disabled by default.
+ * A thread must call dm_pool_set_thread_cache(0) before it exits
+ * to release the chunks it holds.
+ */
+void dm_pool_set_thread_cache(unsigned max_chunks);
+
+struct dm_pool_stats {
+	size_t chunks;		/* Number of chunks owned by the pool */
+	size_t bytes;		/* Total size of these chunks */
+	size_t peak_bytes;	/* Highest value of 'bytes' seen */
+	size_t used_bytes;	/* Bytes handed out including alignment */
+};
+
+void dm_pool_get_stats(struct dm_pool *p, struct dm_pool_stats *stats);
+
 /*
  * To aid debugging, a pool can be locked. Any modifications made
  * to the content of the pool while it is locked can be detected.
@@ -1029,6 +1067,14 @@ void dm_bit_and(dm_bitset_t out, dm_bitset_t in1, dm_bitset_t in2);
 void dm_bit_union(dm_bitset_t out, dm_bitset_t in1, dm_bitset_t in2);
 int dm_bit_get_first(dm_bitset_t bs);
 int dm_bit_get_next(dm_bitset_t bs, int last_bit);
+int dm_bit_get_first_zero(dm_bitset_t bs);
+int dm_bit_get_next_zero(dm_bitset_t bs, int last_bit);
+
+/* Returns number of set bits within the first *bs bits */
+unsigned dm_bit_count(dm_bitset_t bs);
+
+/* Sets all bits from first_bit to last_bit inclusive */
+void dm_bit_range_set(dm_bitset_t bs, unsigned first_bit, unsigned last_bit);
 
 #define DM_BITS_PER_INT (sizeof(int) * CHAR_BIT)
 
@@ -1769,6 +1815,12 @@ int dm_udev_create_cookie(uint32_t *cookie);
 int dm_udev_complete(uint32_t cookie);
 int dm_udev_wait(uint32_t cookie);
 
+/*
+ * Number of dm_udev_wait calls on a cookie so far and the total
+ * time they took in microseconds.
+ */
+void dm_udev_get_wait_stats(unsigned *waits, uint64_t *usecs);
+
 #define DM_DEV_DIR_UMASK 0022
 #define DM_CONTROL_NODE_UMASK 0177
 
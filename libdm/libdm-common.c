@@ -22,7 +22,9 @@
 #include <stdarg.h>
 #include <sys/param.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <dirent.h>
 
 #ifdef UDEV_SYNC_SUPPORT
@@ -159,14 +161,122 @@ static void _default_log(int level, const char *file,
 dm_log_fn dm_log = _default_log;
 dm_log_with_errno_fn dm_log_with_errno = _default_log_with_errno;
 
-void dm_log_init(dm_log_fn fn)
+/*
+ * While node operations of a dm tree run in several threads, messages
+ * are passed to the logging functions one at a time.  The functions in
+ * use are then kept here and dm_log points to a wrapper.
+ */
+static pthread_mutex_t _log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned _log_serialised = 0;
+static dm_log_fn _serialised_log_fn;
+static dm_log_with_errno_fn _serialised_log_with_errno_fn;
+
+/*
+ * Format into buf, or into a buffer from malloc() if the message does
+ * not fit.  Not dm_malloc(): its debugging bookkeeping is not
+ * thread-safe.  Free the result with free() unless it is buf.
+ */
+static char *_format_log_message(char *buf, size_t size,
+				 const char *f, va_list aq)
 {
-	if (fn)
+	char *msg;
+	va_list ap;
+	int n;
+
+	va_copy(ap, aq);
+	n = vsnprintf(buf, size, f, ap);
+	va_end(ap);
+
+	if (n < 0) {
+		*buf = '\0';
+		return buf;
+	}
+
+	/* Keep the truncated message if there is no memory */
+	if ((size_t) n < size || !(msg = malloc((size_t) n + 1)))
+		return buf;
+
+	(void) vsnprintf(msg, (size_t) n + 1, f, aq);
+
+	return msg;
+}
+
+__attribute__((format(printf, 5, 6)))
+static void _serialised_log_with_errno(int level, const char *file, int line,
+				       int dm_errno_or_class, const char *f, ...)
+{
+	char buf[1024], *msg;
+	va_list ap;
+
+	va_start(ap, f);
+	msg = _format_log_message(buf, sizeof(buf), f, ap);
+	va_end(ap);
+
+	pthread_mutex_lock(&_log_mutex);
+	_serialised_log_with_errno_fn(level, file, line, dm_errno_or_class, "%s", msg);
+	pthread_mutex_unlock(&_log_mutex);
+
+	if (msg != buf)
+		free(msg);
+}
+
+__attribute__((format(printf, 4, 5)))
+static void _serialised_log(int level, const char *file, int line,
+			    const char *f, ...)
+{
+	char buf[1024], *msg;
+	va_list ap;
+
+	va_start(ap, f);
+	msg = _format_log_message(buf, sizeof(buf), f, ap);
+	va_end(ap);
+
+	pthread_mutex_lock(&_log_mutex);
+	_serialised_log_fn(level, file, line, "%s", msg);
+	pthread_mutex_unlock(&_log_mutex);
+
+	if (msg != buf)
+		free(msg);
+}
+
+/* Mutex must be held when calling this. */
+static void _set_log_fns(dm_log_fn fn, dm_log_with_errno_fn fn_with_errno)
+{
+	if (!_log_serialised) {
 		dm_log = fn;
-	else
-		dm_log = _default_log;
+		dm_log_with_errno = fn_with_errno;
+		return;
+	}
 
-	dm_log_with_errno = _default_log_with_errno;
+	_serialised_log_fn = fn;
+	_serialised_log_with_errno_fn = fn_with_errno;
+
+	/* Keep dm_log_is_non_default() unchanged */
+	dm_log = (fn == _default_log) ? _default_log : _serialised_log;
+	dm_log_with_errno = _serialised_log_with_errno;
+}
+
+void inc_log_serialised(void)
+{
+	pthread_mutex_lock(&_log_mutex);
+	if (!_log_serialised++)
+		_set_log_fns(dm_log, dm_log_with_errno);
+	pthread_mutex_unlock(&_log_mutex);
+}
+
+void dec_log_serialised(void)
+{
+	pthread_mutex_lock(&_log_mutex);
+	if (!--_log_serialised)
+		_set_log_fns(_serialised_log_fn, _serialised_log_with_errno_fn);
+	pthread_mutex_unlock(&_log_mutex);
+}
+
+void dm_log_init(dm_log_fn fn)
+{
+	pthread_mutex_lock(&_log_mutex);
+	_set_log_fns(fn ? : _default_log, _default_log_with_errno);
+	pthread_mutex_unlock(&_log_mutex);
 }
 
 int dm_log_is_non_default(void)
@@ -176,12 +286,9 @@ int dm_log_is_non_default(void)
 
 void dm_log_with_errno_init(dm_log_with_errno_fn fn)
 {
-	if (fn)
-		dm_log_with_errno = fn;
-	else
-		dm_log_with_errno = _default_log_with_errno;
-
-	dm_log = _default_log;
+	pthread_mutex_lock(&_log_mutex);
+	_set_log_fns(_default_log, fn ? : _default_log_with_errno);
+	pthread_mutex_unlock(&_log_mutex);
 }
 
 void dm_log_init_verbose(int level)
@@ -1282,6 +1389,8 @@ static int _do_node_op(node_op_t type, const char *dev_name, uint32_t major,
 
 static DM_LIST_INIT(_node_ops);
 static int _count_node_ops[NUM_NODES];
+/* Devices may be removed from several threads of a dm tree */
+static pthread_mutex_t _node_ops_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 struct node_op_parms {
 	struct dm_list list;
@@ -1352,11 +1461,11 @@ static void _log_node_op(const char *action_str, struct node_op_parms *nop)
 	}
 }
 
-static int _stack_node_op(node_op_t type, const char *dev_name, uint32_t major,
-			  uint32_t minor, uid_t uid, gid_t gid, mode_t mode,
-			  const char *old_name, uint32_t read_ahead,
-			  uint32_t read_ahead_flags, int warn_if_udev_failed,
-			  unsigned rely_on_udev)
+static int _stack_node_op_locked(node_op_t type, const char *dev_name, uint32_t major,
+				 uint32_t minor, uid_t uid, gid_t gid, mode_t mode,
+				 const char *old_name, uint32_t read_ahead,
+				 uint32_t read_ahead_flags, int warn_if_udev_failed,
+				 unsigned rely_on_udev)
 {
 	struct node_op_parms *nop;
 	struct dm_list *noph, *nopht;
@@ -1448,11 +1557,29 @@ static int _stack_node_op(node_op_t type, const char *dev_name, uint32_t major,
 	return 1;
 }
 
+static int _stack_node_op(node_op_t type, const char *dev_name, uint32_t major,
+			  uint32_t minor, uid_t uid, gid_t gid, mode_t mode,
+			  const char *old_name, uint32_t read_ahead,
+			  uint32_t read_ahead_flags, int warn_if_udev_failed,
+			  unsigned rely_on_udev)
+{
+	int r;
+
+	pthread_mutex_lock(&_node_ops_mutex);
+	r = _stack_node_op_locked(type, dev_name, major, minor, uid, gid, mode,
+				  old_name, read_ahead, read_ahead_flags,
+				  warn_if_udev_failed, rely_on_udev);
+	pthread_mutex_unlock(&_node_ops_mutex);
+
+	return r;
+}
+
 static void _pop_node_ops(void)
 {
 	struct dm_list *noph, *nopht;
 	struct node_op_parms *nop;
 
+	pthread_mutex_lock(&_node_ops_mutex);
 	dm_list_iterate_safe(noph, nopht, &_node_ops) {
 		nop = dm_list_item(noph, struct node_op_parms);
 		if (!nop->rely_on_udev) {
@@ -1465,6 +1592,7 @@ static void _pop_node_ops(void)
 			_log_node_op("Skipping", nop);
 		_del_node_op(nop);
 	}
+	pthread_mutex_unlock(&_node_ops_mutex);
 }
 
 int add_dev_node(const char *dev_name, uint32_t major, uint32_t minor,
@@ -1950,6 +2078,19 @@ static void _set_cookie_flags(struct dm_task *dmt, uint16_t flags)
 	dmt->event_nr = flags << DM_UDEV_FLAGS_SHIFT;
 }
 
+/* Time spent in dm_udev_wait on real cookies */
+static unsigned _udev_wait_count = 0;
+static uint64_t _udev_wait_usecs = 0;
+static pthread_mutex_t _udev_wait_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void dm_udev_get_wait_stats(unsigned *waits, uint64_t *usecs)
+{
+	pthread_mutex_lock(&_udev_wait_stats_mutex);
+	*waits = _udev_wait_count;
+	*usecs = _udev_wait_usecs;
+	pthread_mutex_unlock(&_udev_wait_stats_mutex);
+}
+
 #ifndef UDEV_SYNC_SUPPORT
 void dm_udev_set_sync_support(int sync_with_udev)
 {
@@ -1979,6 +2120,13 @@ int dm_task_set_cookie(struct dm_task *dmt, uint32_t *cookie, uint16_t flags)
 	return 1;
 }
 
+int dm_udev_create_cookie(uint32_t *cookie)
+{
+	*cookie = 0;
+
+	return 1;
+}
+
 int dm_udev_complete(uint32_t cookie)
 {
 	return 1;
@@ -2446,12 +2594,32 @@ repeat_wait:
 	return _udev_notify_sem_destroy(cookie, semid);
 }
 
+static uint64_t _usecs_now(void)
+{
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL))
+		return 0;
+
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 int dm_udev_wait(uint32_t cookie)
 {
+	uint64_t start = cookie ? _usecs_now() : 0;
+	uint64_t usecs;
 	int r = _udev_wait(cookie);
 
 	update_devs();
 
+	if (cookie) {
+		usecs = _usecs_now() - start;
+		pthread_mutex_lock(&_udev_wait_stats_mutex);
+		_udev_wait_count++;
+		_udev_wait_usecs += usecs;
+		pthread_mutex_unlock(&_udev_wait_stats_mutex);
+	}
+
 	return r;
 }
 
@@ -51,4 +51,7 @@ void selinux_release(void);
 void inc_suspended(void);
 void dec_suspended(void);
 
+void inc_log_serialised(void);
+void dec_log_serialised(void);
+
 #endif
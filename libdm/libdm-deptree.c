@@ -18,11 +18,15 @@
 #include "kdev_t.h"
 
 #include <stdarg.h>
+#include <pthread.h>
 #include <sys/param.h>
 #include <sys/utsname.h>
 
 #define MAX_TARGET_PARAMSIZE 500000
 
+/* Worker threads only run ioctls and build table lines */
+#define PARALLEL_THREAD_STACK_SIZE (256 * 1024)
+
 #define REPLICATOR_LOCAL_SITE 0
 
 /* Supported segment types */
@@ -281,6 +285,7 @@ struct dm_tree {
 	int skip_lockfs;		/* 1 skips lockfs (for non-snapshots) */
 	int no_flush;			/* 1 sets noflush (mirrors/multipath) */
 	int retry_remove;		/* 1 retries remove if not successful */
+	unsigned parallel;		/* Max threads for independent nodes */
 	uint32_t cookie;
 };
 
@@ -358,6 +363,15 @@ void dm_tree_retry_remove(struct dm_tree_node *dnode)
 	dnode->dtree->retry_remove = 1;
 }
 
+void dm_tree_set_parallel(struct dm_tree_node *dnode, unsigned max_threads)
+{
+#ifdef DEBUG_MEM
+	/* Memory debugging is not thread-safe */
+	max_threads = 1;
+#endif
+	dnode->dtree->parallel = max_threads;
+}
+
 /*
  * Node functions.
  */
@@ -731,50 +745,71 @@ struct dm_tree_node *dm_tree_next_child(void **handle,
 	return (*dlink) ? dm_list_item(*dlink, struct dm_tree_link)->node : NULL;
 }
 
-static int _deps(struct dm_task **dmt, struct dm_pool *mem, uint32_t major, uint32_t minor,
-		 const char **name, const char **uuid, unsigned inactive_table,
-		 struct dm_info *info, struct dm_deps **deps)
+static struct dm_task *_deps_task(uint32_t major, uint32_t minor,
+				  unsigned inactive_table)
 {
-	memset(info, 0, sizeof(*info));
-
-	if (!dm_is_dm_major(major)) {
-		if (name)
-			*name = "";
-		if (uuid)
-			*uuid = "";
-		*deps = NULL;
-		info->major = major;
-		info->minor = minor;
-		return 1;
-	}
+	struct dm_task *dmt;
 
-	if (!(*dmt = dm_task_create(DM_DEVICE_DEPS))) {
+	if (!(dmt = dm_task_create(DM_DEVICE_DEPS))) {
 		log_error("deps dm_task creation failed");
-		return 0;
+		return NULL;
 	}
 
-	if (!dm_task_set_major(*dmt, major)) {
+	if (!dm_task_set_major(dmt, major)) {
 		log_error("_deps: failed to set major for (%" PRIu32 ":%" PRIu32 ")",
 			  major, minor);
 		goto failed;
 	}
 
-	if (!dm_task_set_minor(*dmt, minor)) {
+	if (!dm_task_set_minor(dmt, minor)) {
 		log_error("_deps: failed to set minor for (%" PRIu32 ":%" PRIu32 ")",
 			  major, minor);
 		goto failed;
 	}
 
-	if (inactive_table && !dm_task_query_inactive_table(*dmt)) {
+	if (inactive_table && !dm_task_query_inactive_table(dmt)) {
 		log_error("_deps: failed to set inactive table for (%" PRIu32 ":%" PRIu32 ")",
 			  major, minor);
 		goto failed;
 	}
 
-	if (!dm_task_run(*dmt)) {
-		log_error("_deps: task run failed for (%" PRIu32 ":%" PRIu32 ")",
-			  major, minor);
-		goto failed;
+	return dmt;
+
+failed:
+	dm_task_destroy(dmt);
+	return NULL;
+}
+
+/*
+ * If *dmt is set, it is a DEPS task for the device that already ran
+ * (see _batch_deps) and only its result is processed here.
+ */
+static int _deps(struct dm_task **dmt, struct dm_pool *mem, uint32_t major, uint32_t minor,
+		 const char **name, const char **uuid, unsigned inactive_table,
+		 struct dm_info *info, struct dm_deps **deps)
+{
+	memset(info, 0, sizeof(*info));
+
+	if (!dm_is_dm_major(major)) {
+		if (name)
+			*name = "";
+		if (uuid)
+			*uuid = "";
+		*deps = NULL;
+		info->major = major;
+		info->minor = minor;
+		return 1;
+	}
+
+	if (!*dmt) {
+		if (!(*dmt = _deps_task(major, minor, inactive_table)))
+			return_0;
+
+		if (!dm_task_run(*dmt)) {
+			log_error("_deps: task run failed for (%" PRIu32 ":%" PRIu32 ")",
+				  major, minor);
+			goto failed;
+		}
 	}
 
 	if (!dm_task_get_info(*dmt, info)) {
@@ -1147,12 +1182,69 @@ struct dm_tree_node *dm_tree_add_new_dev(struct dm_tree *dtree, const char *name
 						   read_only, clear_inactive, context, 0);
 }
 
+/*
+ * Fetch DEPS of all dependencies that are not yet in the tree through
+ * one task batch.  Returns an array (indexed like deps->device) of tasks
+ * that ran, or NULL to let _add_dev() query each device itself.
+ */
+static struct dm_task **_batch_deps(struct dm_tree *dtree, struct dm_deps *deps)
+{
+	struct dm_task_batch *batch;
+	struct dm_task **dmts;
+	uint32_t i, major, minor, count = 0;
+
+	if (deps->count < 2)
+		return NULL;
+
+	if (!(dmts = dm_zalloc(sizeof(*dmts) * deps->count)))
+		return_NULL;
+
+	if (!(batch = dm_task_batch_create()))
+		goto_bad;
+
+	for (i = 0; i < deps->count; i++) {
+		major = MAJOR(deps->device[i]);
+		minor = MINOR(deps->device[i]);
+
+		if (!dm_is_dm_major(major) ||
+		    _find_dm_tree_node(dtree, major, minor))
+			continue;
+
+		if (!(dmts[i] = _deps_task(major, minor, 0)) ||
+		    !dm_task_batch_add(batch, dmts[i]))
+			goto_bad;
+
+		count++;
+	}
+
+	/* On failure each device is queried again to report the error. */
+	if (count && !dm_task_batch_run(batch)) {
+		log_debug_activation("Falling back to unbatched deps queries.");
+		goto bad;
+	}
+
+	dm_task_batch_destroy(batch);
+
+	return dmts;
+
+bad:
+	if (batch)
+		dm_task_batch_destroy(batch);
+	for (i = 0; i < deps->count; i++)
+		if (dmts[i])
+			dm_task_destroy(dmts[i]);
+	dm_free(dmts);
+
+	return NULL;
+}
+
 static struct dm_tree_node *_add_dev(struct dm_tree *dtree,
 				     struct dm_tree_node *parent,
 				     uint32_t major, uint32_t minor,
-				     uint16_t udev_flags)
+				     uint16_t udev_flags,
+				     struct dm_task *dmt)
 {
-	struct dm_task *dmt = NULL;
+	struct dm_task **dep_dmts = NULL;
 	struct dm_info info;
 	struct dm_deps *deps = NULL;
 	const char *name = NULL;
@@ -1191,29 +1283,38 @@ static struct dm_tree_node *_add_dev(struct dm_tree *dtree,
 	}
 
 	/* Add dependencies to tree */
-	for (i = 0; i < deps->count; i++)
+	dep_dmts = _batch_deps(dtree, deps);
+
+	for (i = 0; i < deps->count; i++) {
+		/* _add_dev takes over the task */
 		if (!_add_dev(dtree, node, MAJOR(deps->device[i]),
-			      MINOR(deps->device[i]), udev_flags)) {
+			      MINOR(deps->device[i]), udev_flags,
+			      dep_dmts ? dep_dmts[i] : NULL)) {
 			node = NULL;
+			for (i++; dep_dmts && i < deps->count; i++)
+				if (dep_dmts[i])
+					dm_task_destroy(dep_dmts[i]);
 			goto_out;
 		}
+	}
 
 out:
 	if (dmt)
 		dm_task_destroy(dmt);
+	dm_free(dep_dmts);
 
 	return node;
 }
 
 int dm_tree_add_dev(struct dm_tree *dtree, uint32_t major, uint32_t minor)
 {
-	return _add_dev(dtree, &dtree->root, major, minor, 0) ? 1 : 0;
+	return _add_dev(dtree, &dtree->root, major, minor, 0, NULL) ? 1 : 0;
 }
 
 int dm_tree_add_dev_with_udev_flags(struct dm_tree *dtree, uint32_t major,
 				    uint32_t minor, uint16_t udev_flags)
 {
-	return _add_dev(dtree, &dtree->root, major, minor, udev_flags) ? 1 : 0;
+	return _add_dev(dtree, &dtree->root, major, minor, udev_flags, NULL) ? 1 : 0;
 }
 
 static int _rename_node(const char *old_name, const char *new_name, uint32_t major,
@@ -1511,108 +1612,316 @@ bad:
 }
 
 /*
- * FIXME Don't attempt to deactivate known internal dependencies.
+ * Parallel execution of independent node operations.
+ *
+ * Only the ioctl-issuing part of an operation runs in the worker
+ * threads.  The tree structure and cached node info are updated by
+ * the caller; a udev cookie must exist before the workers start and
+ * node operations they stack are protected by _node_ops_mutex.
+ * Messages are passed to the log function one at a time meanwhile.
  */
-static int _dm_tree_deactivate_children(struct dm_tree_node *dnode,
-					const char *uuid_prefix,
-					size_t uuid_prefix_len,
-					unsigned level)
+typedef int (*parallel_fn)(struct dm_tree_node *dnode, void *context);
+
+struct parallel_run {
+	struct dm_tree_node **nodes;
+	int *results;
+	unsigned count;
+	unsigned next;			/* Next node to hand out */
+	parallel_fn fn;
+	void *context;
+	pthread_mutex_t mutex;
+};
+
+static void *_parallel_worker(void *arg)
 {
+	struct parallel_run *run = arg;
+	unsigned i;
+
+	while (1) {
+		pthread_mutex_lock(&run->mutex);
+		i = run->next++;
+		pthread_mutex_unlock(&run->mutex);
+
+		if (i >= run->count)
+			break;
+
+		run->results[i] = run->fn(run->nodes[i], run->context);
+	}
+
+	return NULL;
+}
+
+/*
+ * Run fn on all nodes using up to max_threads threads including
+ * the calling one and store its return values in results.
+ * Returns 0 if fn failed for any node.
+ */
+static int _parallel_run(struct dm_tree_node **nodes, unsigned count,
+			 unsigned max_threads, parallel_fn fn, void *context,
+			 int *results)
+{
+	struct parallel_run run = {
+		.nodes = nodes,
+		.results = results,
+		.count = count,
+		.fn = fn,
+		.context = context,
+	};
+	pthread_attr_t attr;
+	pthread_t *threads;
+	unsigned i, started = 0;
 	int r = 1;
-	void *handle = NULL;
-	struct dm_tree_node *child = dnode;
+
+	if (max_threads > count)
+		max_threads = count;
+
+	if (max_threads < 2) {
+		for (i = 0; i < count; i++)
+			if (!(results[i] = fn(nodes[i], context)))
+				r = 0;
+		return r;
+	}
+
+	if (!(threads = dm_malloc(sizeof(*threads) * (max_threads - 1)))) {
+		log_error("Failed to allocate parallel run.");
+		return 0;
+	}
+
+	pthread_mutex_init(&run.mutex, NULL);
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PARALLEL_THREAD_STACK_SIZE);
+
+	inc_log_serialised();
+
+	/* If threads can't be created, fewer workers do the job */
+	for (; started < max_threads - 1; started++)
+		if (pthread_create(&threads[started], &attr, _parallel_worker, &run))
+			break;
+
+	(void) _parallel_worker(&run);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	dec_log_serialised();
+
+	log_debug_activation("Processed %u nodes with %u threads.", count, started + 1);
+
+	for (i = 0; i < count; i++)
+		if (!results[i])
+			r = 0;
+
+	pthread_attr_destroy(&attr);
+	pthread_mutex_destroy(&run.mutex);
+	dm_free(threads);
+
+	return r;
+}
+
+/*
+ * Checks done by _dm_tree_deactivate_children before removing child.
+ * Refreshes child's info and suspends it first if requested.
+ * Returns 0 if child is to be skipped, clearing *r on error.
+ */
+static int _deactivate_check_child(struct dm_tree_node *child,
+				   const char *uuid_prefix,
+				   size_t uuid_prefix_len,
+				   unsigned level, int *r)
+{
 	struct dm_info info;
 	const struct dm_info *dinfo;
 	const char *name;
 	const char *uuid;
 
-	while ((child = dm_tree_next_child(&handle, dnode, 0))) {
-		if (!(dinfo = dm_tree_node_get_info(child))) {
-			stack;
-			continue;
+	if (!(dinfo = dm_tree_node_get_info(child))) {
+		stack;
+		return 0;
+	}
+
+	if (!(name = dm_tree_node_get_name(child))) {
+		stack;
+		return 0;
+	}
+
+	if (!(uuid = dm_tree_node_get_uuid(child))) {
+		stack;
+		return 0;
+	}
+
+	/* Ignore if it doesn't belong to this VG */
+	if (!_uuid_prefix_matches(uuid, uuid_prefix, uuid_prefix_len))
+		return 0;
+
+	/* Refresh open_count */
+	if (!_info_by_dev(dinfo->major, dinfo->minor, 1, &info, NULL, NULL, NULL) ||
+	    !info.exists)
+		return 0;
+
+	if (info.open_count) {
+		/* Skip internal non-toplevel opened nodes */
+		if (level)
+			return 0;
+
+		/* When retry is not allowed, error */
+		if (!child->dtree->retry_remove) {
+			log_error("Unable to deactivate open %s (%" PRIu32
+				  ":%" PRIu32 ")", name, info.major, info.minor);
+			*r = 0;
+			return 0;
 		}
 
-		if (!(name = dm_tree_node_get_name(child))) {
+		/* Check toplevel node for holders/mounted fs */
+		if (!_check_device_not_in_use(name, &info)) {
 			stack;
-			continue;
+			*r = 0;
+			return 0;
 		}
+		/* Go on with retry */
+	}
 
-		if (!(uuid = dm_tree_node_get_uuid(child))) {
-			stack;
-			continue;
+	/* Also checking open_count in parent nodes of presuspend_node */
+	if ((child->presuspend_node &&
+	     !_node_has_closed_parents(child->presuspend_node,
+				       uuid_prefix, uuid_prefix_len))) {
+		/* Only report error from (likely non-internal) dependency at top level */
+		if (!level) {
+			log_error("Unable to deactivate open %s (%" PRIu32
+				  ":%" PRIu32 ")", name, info.major,
+			  	info.minor);
+			*r = 0;
 		}
+		return 0;
+	}
 
-		/* Ignore if it doesn't belong to this VG */
-		if (!_uuid_prefix_matches(uuid, uuid_prefix, uuid_prefix_len))
-			continue;
+	/* Suspend child node first if requested */
+	if (child->presuspend_node &&
+	    !dm_tree_suspend_children(child, uuid_prefix, uuid_prefix_len))
+		return 0;
 
-		/* Refresh open_count */
-		if (!_info_by_dev(dinfo->major, dinfo->minor, 1, &info, NULL, NULL, NULL) ||
-		    !info.exists)
-			continue;
+	child->info = info;
 
-		if (info.open_count) {
-			/* Skip internal non-toplevel opened nodes */
-			if (level)
-				continue;
+	return 1;
+}
 
-			/* When retry is not allowed, error */
-			if (!child->dtree->retry_remove) {
-				log_error("Unable to deactivate open %s (%" PRIu32
-					  ":%" PRIu32 ")", name, info.major, info.minor);
-				r = 0;
-				continue;
-			}
+static int _dm_tree_deactivate_children(struct dm_tree_node *dnode,
+					const char *uuid_prefix,
+					size_t uuid_prefix_len,
+					unsigned level);
 
-			/* Check toplevel node for holders/mounted fs */
-			if (!_check_device_not_in_use(name, &info)) {
-				stack;
-				r = 0;
-				continue;
-			}
-			/* Go on with retry */
-		}
+/* Work done by _dm_tree_deactivate_children after removing child */
+static int _deactivate_finish_child(struct dm_tree_node *child,
+				    const char *uuid_prefix,
+				    size_t uuid_prefix_len,
+				    unsigned level, int removed, int *r)
+{
+	if (!removed) {
+		log_error("Unable to deactivate %s (%" PRIu32
+			  ":%" PRIu32 ")", child->name, child->info.major,
+			  child->info.minor);
+		*r = 0;
+		return 1;
+	} else if (child->info.suspended && child->info.live_table)
+		dec_suspended();
 
-		/* Also checking open_count in parent nodes of presuspend_node */
-		if ((child->presuspend_node &&
-		     !_node_has_closed_parents(child->presuspend_node,
-					       uuid_prefix, uuid_prefix_len))) {
-			/* Only report error from (likely non-internal) dependency at top level */
-			if (!level) {
-				log_error("Unable to deactivate open %s (%" PRIu32
-					  ":%" PRIu32 ")", name, info.major,
-				  	info.minor);
-				r = 0;
-			}
-			continue;
-		}
+	if (child->callback &&
+	    !child->callback(child, DM_NODE_CALLBACK_DEACTIVATED,
+			     child->callback_data))
+		stack;
+		// FIXME: We need to let lvremove pass,
+		// so for now deactivation ignores check result
+		//r = 0; // FIXME: _node_clear_table() without callback ?
 
-		/* Suspend child node first if requested */
-		if (child->presuspend_node &&
-		    !dm_tree_suspend_children(child, uuid_prefix, uuid_prefix_len))
-			continue;
+	if (dm_tree_node_num_children(child, 0) &&
+	    !_dm_tree_deactivate_children(child, uuid_prefix, uuid_prefix_len, level + 1))
+		return_0;
 
-		if (!_deactivate_node(name, info.major, info.minor,
-				      &child->dtree->cookie, child->udev_flags,
-				      (level == 0) ? child->dtree->retry_remove : 0)) {
-			log_error("Unable to deactivate %s (%" PRIu32
-				  ":%" PRIu32 ")", name, info.major,
-				  info.minor);
+	return 1;
+}
+
+static int _deactivate_node_parallel(struct dm_tree_node *dnode, void *retry)
+{
+	return _deactivate_node(dnode->name, dnode->info.major, dnode->info.minor,
+				&dnode->dtree->cookie, dnode->udev_flags,
+				*(int *) retry);
+}
+
+/*
+ * Remove all children that pass the checks concurrently.  Their
+ * subtrees are processed afterwards, so a device is still only
+ * removed once nothing in the tree uses it.  The udev cookie is
+ * created before the threads start so they only add to it.
+ */
+static int _deactivate_children_parallel(struct dm_tree_node *dnode,
+					 const char *uuid_prefix,
+					 size_t uuid_prefix_len,
+					 unsigned level)
+{
+	void *handle = NULL;
+	struct dm_tree_node *child, **children;
+	unsigned i, count = 0;
+	unsigned num_children = dm_tree_node_num_children(dnode, 0);
+	int retry = (level == 0) ? dnode->dtree->retry_remove : 0;
+	int *results;
+	int r = 1;
+
+	if (!(children = dm_malloc(num_children * (sizeof(*children) + sizeof(*results))))) {
+		log_error("Failed to allocate deactivation children list.");
+		return 0;
+	}
+	results = (int *) (children + num_children);
+
+	while ((child = dm_tree_next_child(&handle, dnode, 0)))
+		if (_deactivate_check_child(child, uuid_prefix, uuid_prefix_len, level, &r))
+			children[count++] = child;
+
+	if (count && !dnode->dtree->cookie &&
+	    !dm_udev_create_cookie(&dnode->dtree->cookie)) {
+		r = 0;
+		goto_out;
+	}
+
+	(void) _parallel_run(children, count, dnode->dtree->parallel,
+			     _deactivate_node_parallel, &retry, results);
+
+	for (i = 0; i < count; i++)
+		if (!_deactivate_finish_child(children[i], uuid_prefix, uuid_prefix_len,
+					      level, results[i], &r)) {
 			r = 0;
+			goto_out;
+		}
+out:
+	dm_free(children);
+
+	return r;
+}
+
+/*
+ * FIXME Don't attempt to deactivate known internal dependencies.
+ */
+static int _dm_tree_deactivate_children(struct dm_tree_node *dnode,
+					const char *uuid_prefix,
+					size_t uuid_prefix_len,
+					unsigned level)
+{
+	int r = 1;
+	void *handle = NULL;
+	struct dm_tree_node *child = dnode;
+	int removed;
+
+	if (dnode->dtree->parallel > 1 && dm_tree_node_num_children(dnode, 0) > 1)
+		return _deactivate_children_parallel(dnode, uuid_prefix,
+						     uuid_prefix_len, level);
+
+	while ((child = dm_tree_next_child(&handle, dnode, 0))) {
+		if (!_deactivate_check_child(child, uuid_prefix, uuid_prefix_len, level, &r))
 			continue;
-		} else if (info.suspended && info.live_table)
-			dec_suspended();
 
-		if (child->callback &&
-		    !child->callback(child, DM_NODE_CALLBACK_DEACTIVATED,
-				     child->callback_data))
-			stack;
-			// FIXME: We need to let lvremove pass,
-			// so for now deactivation ignores check result
-			//r = 0; // FIXME: _node_clear_table() without callback ?
+		removed = _deactivate_node(child->name, child->info.major, child->info.minor,
+					   &child->dtree->cookie, child->udev_flags,
+					   (level == 0) ? child->dtree->retry_remove : 0);
 
-		if (dm_tree_node_num_children(child, 0) &&
-		    !_dm_tree_deactivate_children(child, uuid_prefix, uuid_prefix_len, level + 1))
+		if (!_deactivate_finish_child(child, uuid_prefix, uuid_prefix_len,
+					      level, removed, &r))
 			return_0;
 	}
 
@@ -1870,6 +2179,63 @@ do {\
 	p += w;\
 } while (0)
 
+/* Worst case " major:minor offset" emitted for one linear or striped area */
+#define PLAIN_AREA_PARAMSIZE	44
+
+/*
+ * Write decimal value v so that it ends just before end.
+ * Returns pointer to its first character.
+ */
+static char *_format_uint_backwards(char *end, uint64_t v)
+{
+	do {
+		*--end = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v);
+
+	return end;
+}
+
+/*
+ * Emit "major:minor offset" pairs of linear and striped segments.
+ * Tables with thousands of areas spend most of their time here,
+ * so avoid going through printf for each number.
+ *
+ * Returns: 1 on success, -1 when out of space
+ */
+static int _emit_plain_areas_line(struct load_segment *seg, char *params,
+				  size_t paramsize, int *pos)
+{
+	struct seg_area *area;
+	char buf[PLAIN_AREA_PARAMSIZE];
+	char *p;
+	size_t len;
+	unsigned first_time = 1;
+
+	dm_list_iterate_items(area, &seg->areas) {
+		p = _format_uint_backwards(buf + sizeof(buf), area->offset);
+		*--p = ' ';
+		p = _format_uint_backwards(p, area->dev_node->info.minor);
+		*--p = ':';
+		p = _format_uint_backwards(p, area->dev_node->info.major);
+		if (!first_time)
+			*--p = ' ';
+		first_time = 0;
+
+		len = (size_t) (buf + sizeof(buf) - p);
+		if ((size_t) *pos + len >= paramsize) {
+			stack; /* Out of space */
+			return -1;
+		}
+
+		memcpy(params + *pos, p, len);
+		*pos += (int) len;
+		params[*pos] = '\0';
+	}
+
+	return 1;
+}
+
 /*
  * _emit_areas_line
  *
@@ -1885,6 +2251,9 @@ static int _emit_areas_line(struct dm_task *dmt __attribute__((unused)),
 	const char *logtype, *synctype;
 	unsigned log_parm_count;
 
+	if (seg->type == SEG_LINEAR || seg->type == SEG_STRIPED)
+		return _emit_plain_areas_line(seg, params, paramsize, pos);
+
 	dm_list_iterate_items(area, &seg->areas) {
 		switch (seg->type) {
 		case SEG_REPLICATOR_DEV:
@@ -2383,6 +2752,10 @@ static int _emit_segment(struct dm_task *dmt, uint32_t major, uint32_t minor,
 	size_t paramsize = 4096;
 	int ret;
 
+	/* Size the buffer up front instead of retrying with doubled sizes */
+	if (seg->type == SEG_LINEAR || seg->type == SEG_STRIPED)
+		paramsize += (size_t) seg->area_count * PLAIN_AREA_PARAMSIZE;
+
 	do {
 		if (!(params = dm_malloc(paramsize))) {
 			log_error("Insufficient space for target parameters.");
@@ -2482,6 +2855,130 @@ out:
 	return r;
 }
 
+static int _preload_skip_child(struct dm_tree_node *child,
+			       const char *uuid_prefix, size_t uuid_prefix_len)
+{
+	/* Skip existing non-device-mapper devices */
+	if (!child->info.exists && child->info.major)
+		return 1;
+
+	/* Ignore if it doesn't belong to this VG */
+	if (child->info.exists &&
+	    !_uuid_prefix_matches(child->uuid, uuid_prefix, uuid_prefix_len))
+		return 1;
+
+	return 0;
+}
+
+static int _preload_needs_load(struct dm_tree_node *child)
+{
+	return !child->info.inactive_table && child->props.segment_count;
+}
+
+static int _load_node_parallel(struct dm_tree_node *dnode,
+			       void *context __attribute__((unused)))
+{
+	return _load_node(dnode);
+}
+
+/*
+ * Parallel variant of the children loop in dm_tree_preload_children.
+ * Subtrees are preloaded and missing devices created first, then the
+ * tables of all children, which are now independent, are loaded
+ * concurrently and finally any resumes are done in the original order.
+ * A failed resume only clears *resumed_ok, like in the serial loop.
+ */
+static int _preload_children_parallel(struct dm_tree_node *dnode,
+				      const char *uuid_prefix,
+				      size_t uuid_prefix_len,
+				      int *update_devs_flag,
+				      int *resumed_ok)
+{
+	void *handle = NULL;
+	struct dm_tree_node *child, **children, **loads;
+	struct dm_info newinfo;
+	unsigned i, count = 0, load_count = 0;
+	unsigned num_children = dm_tree_node_num_children(dnode, 0);
+	int *results;
+	int r = 0;
+
+	if (!(children = dm_malloc(num_children * (2 * sizeof(*children) + sizeof(*results))))) {
+		log_error("Failed to allocate preload children list.");
+		return 0;
+	}
+	loads = children + num_children;
+	results = (int *) (loads + num_children);
+
+	while ((child = dm_tree_next_child(&handle, dnode, 0))) {
+		if (_preload_skip_child(child, uuid_prefix, uuid_prefix_len))
+			continue;
+
+		if (dm_tree_node_num_children(child, 0))
+			if (!dm_tree_preload_children(child, uuid_prefix, uuid_prefix_len))
+				goto_out;
+
+		/* FIXME Cope if name exists with no uuid? */
+		if (!child->info.exists && !_create_node(child))
+			goto_out;
+
+		children[count++] = child;
+	}
+
+	/* A child may have been loaded meanwhile as part of a sibling's subtree */
+	for (i = 0; i < count; i++)
+		if (_preload_needs_load(children[i]))
+			loads[load_count++] = children[i];
+
+	if (!_parallel_run(loads, load_count, dnode->dtree->parallel,
+			   _load_node_parallel, NULL, results))
+		goto_out;
+
+	for (i = 0; i < count; i++) {
+		child = children[i];
+
+		/* Propagate device size change change */
+		if (child->props.size_changed)
+			dnode->props.size_changed = 1;
+
+		/* Resume device immediately if it has parents and its size changed */
+		if (!dm_tree_node_num_children(child, 1) || !child->props.size_changed)
+			continue;
+
+		if (!child->info.inactive_table && !child->info.suspended)
+			continue;
+
+		if (!_resume_node(child->name, child->info.major, child->info.minor,
+				  child->props.read_ahead, child->props.read_ahead_flags,
+				  &newinfo, &child->dtree->cookie, child->udev_flags,
+				  child->info.suspended)) {
+			log_error("Unable to resume %s (%" PRIu32
+				  ":%" PRIu32 ")", child->name, child->info.major,
+				  child->info.minor);
+			/* If the device was not previously active, we might as well remove this node. */
+			if (!child->info.live_table &&
+			    !_deactivate_node(child->name, child->info.major,child->info.minor,
+					      &child->dtree->cookie, child->udev_flags, 0))
+				log_error("Unable to deactivate %s (%" PRIu32
+					  ":%" PRIu32 ")", child->name, child->info.major,
+					  child->info.minor);
+			*resumed_ok = 0;
+			/* Each child is handled independently */
+			continue;
+		}
+
+		/* Update cached info */
+		child->info = newinfo;
+		if (child->props.immediate_dev_node)
+			*update_devs_flag = 1;
+	}
+
+	r = 1;
+out:
+	dm_free(children);
+
+	return r;
+}
+
 int dm_tree_preload_children(struct dm_tree_node *dnode,
 			     const char *uuid_prefix,
 			     size_t uuid_prefix_len)
@@ -2492,15 +2989,17 @@ int dm_tree_preload_children(struct dm_tree_node *dnode,
 	struct dm_info newinfo;
 	int update_devs_flag = 0;
 
+	if (dnode->dtree->parallel > 1) {
+		if (!_preload_children_parallel(dnode, uuid_prefix, uuid_prefix_len,
+						&update_devs_flag, &r))
+			return_0;
+		child = NULL;
+		goto wait;
+	}
+
 	/* Preload children first */
 	while ((child = dm_tree_next_child(&handle, dnode, 0))) {
-		/* Skip existing non-device-mapper devices */
-		if (!child->info.exists && child->info.major)
-			continue;
-
-		/* Ignore if it doesn't belong to this VG */
-		if (child->info.exists &&
-		    !_uuid_prefix_matches(child->uuid, uuid_prefix, uuid_prefix_len))
+		if (_preload_skip_child(child, uuid_prefix, uuid_prefix_len))
 			continue;
 
 		if (dm_tree_node_num_children(child, 0))
@@ -2511,9 +3010,7 @@ int dm_tree_preload_children(struct dm_tree_node *dnode,
 		if (!child->info.exists && !_create_node(child))
 			return_0;
 
-		if (!child->info.inactive_table &&
-		    child->props.segment_count &&
-		    !_load_node(child))
+		if (_preload_needs_load(child) && !_load_node(child))
 			return_0;
 
 		/* Propagate device size change change */
@@ -2557,6 +3054,7 @@ int dm_tree_preload_children(struct dm_tree_node *dnode,
 			update_devs_flag = 1;
 	}
 
+wait:
 	if (update_devs_flag ||
 	    (!dnode->info.exists && dnode->callback)) {
 		if (!dm_udev_wait(dm_tree_get_cookie(dnode)))
@@ -3552,7 +4050,7 @@ int dm_tree_node_add_target_area(struct dm_tree_node *node,
 
 		/* FIXME Check correct macro use */
 		if (!(dev_node = _add_dev(node->dtree, node, MAJOR(info.st_rdev),
-					  MINOR(info.st_rdev), 0)))
+					  MINOR(info.st_rdev), 0, NULL)))
 			return_0;
 	}
 
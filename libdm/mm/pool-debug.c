@@ -214,6 +214,19 @@ void dm_pool_free(struct dm_pool *p, void *ptr)
 	_pool_stats(p, "Freeing (after)");
 }
 
+void dm_pool_set_thread_cache(unsigned max_chunks __attribute__((unused)))
+{
+	/* Each debug allocation is a separate malloc - nothing to cache. */
+}
+
+void dm_pool_get_stats(struct dm_pool *p, struct dm_pool_stats *stats)
+{
+	stats->chunks = p->stats.blocks_allocated;
+	stats->bytes = p->stats.bytes;
+	stats->peak_bytes = p->stats.maxbytes;
+	stats->used_bytes = p->stats.bytes;
+}
+
 int dm_pool_begin_object(struct dm_pool *p, size_t init_size)
 {
 	assert(!p->begun);
@@ -36,11 +36,26 @@ struct dm_pool {
 	unsigned object_alignment;
 	int locked;
 	long crc;
+	size_t chunks;
+	size_t bytes;
+	size_t peak_bytes;
 };
 
+/*
+ * Per-thread list of released chunks (linked through 'prev'),
+ * enabled with dm_pool_set_thread_cache().
+ */
+static __thread struct chunk *_thread_cache;
+static __thread unsigned _thread_cache_count;
+static __thread unsigned _thread_cache_max;
+
+/* Larger chunks are always returned to malloc */
+#define THREAD_CACHE_MAX_CHUNK_SIZE (1024 * 1024)
+
 static void _align_chunk(struct chunk *c, unsigned alignment);
 static struct chunk *_new_chunk(struct dm_pool *p, size_t s);
-static void _free_chunk(struct chunk *c);
+static void _free_chunk(struct dm_pool *p, struct chunk *c);
+static void _release_chunk(struct chunk *c);
 
 /* by default things come out aligned for doubles */
 #define DEFAULT_ALIGNMENT __alignof__ (double)
@@ -69,11 +84,11 @@ struct dm_pool *dm_pool_create(const char *name, size_t chunk_hint)
 void dm_pool_destroy(struct dm_pool *p)
 {
 	struct chunk *c, *pr;
-	_free_chunk(p->spare_chunk);
+	_free_chunk(p, p->spare_chunk);
 	c = p->chunk;
 	while (c) {
 		pr = c->prev;
-		_free_chunk(c);
+		_free_chunk(p, c);
 		c = pr;
 	}
 
@@ -144,7 +159,7 @@ void dm_pool_free(struct dm_pool *p, void *ptr)
 		}
 
 		if (p->spare_chunk)
-			_free_chunk(p->spare_chunk);
+			_free_chunk(p, p->spare_chunk);
 
 		c->begin = (char *) (c + 1);
 #ifdef VALGRIND_POOL
@@ -249,11 +264,69 @@ void dm_pool_abandon_object(struct dm_pool *p)
 	p->object_alignment = DEFAULT_ALIGNMENT;
 }
 
+void dm_pool_set_thread_cache(unsigned max_chunks)
+{
+	struct chunk *c;
+
+	_thread_cache_max = max_chunks;
+
+	while (_thread_cache_count > max_chunks) {
+		c = _thread_cache;
+		_thread_cache = c->prev;
+		_thread_cache_count--;
+		_release_chunk(c);
+	}
+}
+
+void dm_pool_get_stats(struct dm_pool *p, struct dm_pool_stats *stats)
+{
+	const struct chunk *c;
+
+	stats->chunks = p->chunks;
+	stats->bytes = p->bytes;
+	stats->peak_bytes = p->peak_bytes;
+	stats->used_bytes = 0;
+
+	for (c = p->chunk; c; c = c->prev)
+		if (c->begin > (char *) (c + 1))
+			stats->used_bytes += c->begin - (char *) (c + 1);
+}
+
 static void _align_chunk(struct chunk *c, unsigned alignment)
 {
 	c->begin += alignment - ((unsigned long) c->begin & (alignment - 1));
 }
 
+/* Take a chunk of size between s and 2*s from the thread cache */
+static struct chunk *_get_cached_chunk(size_t s)
+{
+	struct chunk *c, **prev;
+	size_t size;
+
+	for (prev = &_thread_cache; (c = *prev); prev = &c->prev) {
+		size = c->end - (char *) c;
+		if (size >= s && size <= 2 * s) {
+			*prev = c->prev;
+			_thread_cache_count--;
+			c->begin = (char *) (c + 1);
+#ifdef VALGRIND_POOL
+			VALGRIND_MAKE_MEM_NOACCESS(c->begin, c->end - c->begin);
+#endif
+			return c;
+		}
+	}
+
+	return NULL;
+}
+
+static void _count_chunk(struct dm_pool *p, struct chunk *c)
+{
+	p->chunks++;
+	p->bytes += c->end - (char *) c;
+	if (p->bytes > p->peak_bytes)
+		p->peak_bytes = p->bytes;
+}
+
 static struct chunk *_new_chunk(struct dm_pool *p, size_t s)
 {
 	struct chunk *c;
@@ -263,6 +336,9 @@ static struct chunk *_new_chunk(struct dm_pool *p, size_t s)
 		/* reuse old chunk */
 		c = p->spare_chunk;
 		p->spare_chunk = 0;
+	} else if (_thread_cache_count && (c = _get_cached_chunk(s))) {
+		/* reuse chunk released by a pool of this thread */
+		_count_chunk(p, c);
 	} else {
 #ifdef DEBUG_ENFORCE_POOL_LOCKING
 		if (!pagesize) {
@@ -292,6 +368,7 @@ static struct chunk *_new_chunk(struct dm_pool *p, size_t s)
 #ifdef VALGRIND_POOL
 		VALGRIND_MAKE_MEM_NOACCESS(c->begin, c->end - c->begin);
 #endif
+		_count_chunk(p, c);
 	}
 
 	c->prev = p->chunk;
@@ -299,7 +376,32 @@ static struct chunk *_new_chunk(struct dm_pool *p, size_t s)
 	return c;
 }
 
-static void _free_chunk(struct chunk *c)
+static void _free_chunk(struct dm_pool *p, struct chunk *c)
+{
+	size_t size;
+
+	if (!c)
+		return;
+
+	size = c->end - (char *) c;
+	p->chunks--;
+	p->bytes -= size;
+
+	if (_thread_cache_count < _thread_cache_max &&
+	    size <= THREAD_CACHE_MAX_CHUNK_SIZE) {
+#ifdef VALGRIND_POOL
+		VALGRIND_MAKE_MEM_NOACCESS(c + 1, c->end - (char *) (c + 1));
+#endif
+		c->prev = _thread_cache;
+		_thread_cache = c;
+		_thread_cache_count++;
+		return;
+	}
+
+	_release_chunk(c);
+}
+
+static void _release_chunk(struct chunk *c)
 {
 #ifdef VALGRIND_POOL
 #  ifdef DEBUG_MEM
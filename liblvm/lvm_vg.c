@@ -145,6 +145,10 @@ int lvm_vg_write(vg_t vg)
 	if (!vg_write(vg) || !vg_commit(vg))
 		return -1;
 
+	/* Deferred backups are cheap enough to keep current here */
+	if (backup_is_deferred(vg->cmd))
+		backup(vg);
+
 	if (! dm_list_empty(&vg->removed_pvs)) {
 		dm_list_iterate_items(pvl, &vg->removed_pvs) {
 			pv_write_orphan(vg->cmd, pvl->pv);
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+# Deferred archives and backups are all on disk once the VG is unlocked
+
+. lib/test
+
+aux prepare_pvs 2
+
+aux lvmconf "backup/backup = 1" "backup/archive = 1" "backup/defer = 1" \
+	    "backup/backup_dir = \"$TESTDIR/backup\"" \
+	    "backup/archive_dir = \"$TESTDIR/archive\""
+
+backup_is_current() {
+	grep "seqno = $(get vg_field $1 vg_seqno)\$" "$TESTDIR/backup/$1"
+}
+
+vgcreate $vg "$dev1" "$dev2"
+lvcreate -an -Zn -l 1 -n $lv1 $vg "$dev1"
+lvcreate -an -Zn -l 1 -n $lv2 $vg "$dev1"
+vgchange --addtag tag1 $vg
+
+# The backup holds the latest metadata
+backup_is_current $vg
+grep "tag1" "$TESTDIR/backup/$vg"
+
+# Every change was archived, none coalesced with the next one
+seqno=$(get vg_field $vg vg_seqno)
+test $(ls "$TESTDIR/archive/${vg}_"*.vg | wc -l) -eq $(( seqno - 1 ))
+for s in $(seq 1 $(( seqno - 1 ))); do
+	grep -l "seqno = $s\$" "$TESTDIR/archive/${vg}_"*.vg
+done
+
+# Both VGs written by one command are flushed
+vgsplit $vg $vg1 "$dev2"
+backup_is_current $vg
+backup_is_current $vg1
+
+# The backup restores the VG it describes
+cp "$TESTDIR/backup/$vg" backup.vg
+lvremove -ff $vg/$lv1
+backup_is_current $vg
+vgcfgrestore -f backup.vg $vg
+check lv_exists $vg $lv1
+
+# vgcfgbackup writes immediately even with deferred backups
+rm -f "$TESTDIR/backup/$vg"
+vgcfgbackup $vg
+backup_is_current $vg
+
+vgremove -ff $vg $vg1
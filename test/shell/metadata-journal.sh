@@ -0,0 +1,56 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+. lib/test
+
+# Header version and flags of the first raw location of an mda
+mda_version() {
+	od -An -tu4 -j $(( $2 + 20 )) -N4 "$1" | tr -d ' '
+}
+
+mda_flags() {
+	od -An -tu4 -j $(( $2 + 60 )) -N4 "$1" | tr -d ' '
+}
+
+mda_offsets() {
+	pvck -v "$1" 2>&1 | \
+		sed -n 's/.*Found text metadata area: offset=\([0-9]*\),.*/\1/p'
+}
+
+aux prepare_devs 2
+
+pvcreate --metadatacopies 2 "$dev1"
+pvcreate "$dev2"
+
+aux lvmconf "metadata/journal = 1"
+
+vgcreate $vg "$dev1" "$dev2"
+vgchange --addtag first $vg
+vgchange --addtag second $vg
+check vg_field $vg vg_tags "first,second"
+
+# Every in-sync mda holds a journal record after the second write
+test $(mda_offsets "$dev1" | wc -l) -eq 2
+for dev in "$dev1" "$dev2"; do
+	for off in $(mda_offsets "$dev"); do
+		test "$(mda_version "$dev" $off)" -eq 2
+		test "$(mda_flags "$dev" $off)" -eq 2
+	done
+done
+
+# Orphaned PVs are readable by tools without journal support
+vgremove -ff $vg
+for dev in "$dev1" "$dev2"; do
+	for off in $(mda_offsets "$dev"); do
+		test "$(mda_version "$dev" $off)" -eq 1
+		test "$(mda_flags "$dev" $off)" -eq 0
+	done
+done
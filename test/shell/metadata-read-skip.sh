@@ -0,0 +1,87 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+# Copies with the checksum of one already read are not parsed again.
+# A stale copy among them must still be found and repaired.
+
+. lib/test
+
+# Only vgscan notices inconsistencies when lvmetad is active
+test -e LOCAL_LVMETAD && skip
+
+# 32bit field of the first raw location of the mda at offset $2 of $1
+rlocn_field() {
+	od -An -tu4 -j $(( $2 + $3 )) -N4 "$1" | tr -d ' '
+}
+
+mda_offsets() {
+	pvck -v "$1" 2>&1 | \
+		sed -n 's/.*Found text metadata area: offset=\([0-9]*\),.*/\1/p'
+}
+
+# Print the checksum, version and flags of every mda
+mda_state() {
+	local dev off
+
+	for dev in "$dev1" "$dev2" "$dev3"; do
+		for off in $(mda_offsets "$dev"); do
+			echo $(rlocn_field "$dev" $off 56) \
+			     $(rlocn_field "$dev" $off 20) \
+			     $(rlocn_field "$dev" $off 60)
+		done
+	done
+}
+
+# Make the copy on dev2 one change older than the others
+stale_dev2() {
+	aux backup_dev "$dev2"
+	lvchange --addtag $1 $vg/$lv1
+	aux restore_dev "$dev2"
+}
+
+aux prepare_pvs 3
+pvcreate --metadatacopies 2 "$dev1"
+vgcreate $vg "$dev1" "$dev2" "$dev3"
+lvcreate -an -Zn -l 1 -n $lv1 $vg
+
+stale_dev2 first
+
+vgs $vg 2>&1 | tee cmd.out
+grep "Inconsistent metadata found for VG $vg" cmd.out
+vgs $vg 2>&1 | tee cmd.out
+not grep "Inconsistent metadata found for VG $vg" cmd.out
+check lv_field $vg/$lv1 lv_tags first
+
+# All four copies are identical again
+test $(mda_state | wc -l) -eq 4
+test $(mda_state | sort -u | wc -l) -eq 1
+
+echo Journaled copies keep their state when skipped on read
+aux lvmconf "metadata/journal = 1"
+
+lvchange --addtag second $vg/$lv1
+stale_dev2 third
+
+vgs $vg 2>&1 | tee cmd.out
+grep "Inconsistent metadata found for VG $vg" cmd.out
+check lv_field $vg/$lv1 lv_tags "first,second,third"
+
+# The next write appends a journal record to every copy
+lvchange --addtag fourth $vg/$lv1
+mda_state | while read crc version flags; do
+	test "$version" -eq 2
+	test "$flags" -eq 2
+done
+vgs $vg 2>&1 | tee cmd.out
+not grep "Inconsistent metadata found for VG $vg" cmd.out
+check lv_field $vg/$lv1 lv_tags "first,second,third,fourth"
+
+vgremove -ff $vg
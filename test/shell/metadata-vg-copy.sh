@@ -0,0 +1,57 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+# The on-disk copy of a VG is built without a text round trip.
+# With global/detect_internal_vg_cache_corruption set (as in the test
+# configuration), every copy is compared against the round trip and a
+# mismatch is an internal error.
+
+. lib/test
+
+aux prepare_vg 5
+
+vgchange --addtag vgtag $vg
+
+lvcreate -l 2 -n linear --addtag lvtag $vg
+lvcreate -l 4 -i 2 -n striped $vg
+lvcreate -l 2 -m 1 --type mirror --mirrorlog core -n mirror $vg
+lvcreate -s -l 1 -n snap $vg/linear
+
+if aux have_thin 1 0 0 ; then
+	lvcreate -L 4M -T $vg/pool
+	lvcreate -V 8M -T $vg/pool -n thin
+	lvcreate -s $vg/thin -n thinsnap
+fi
+
+if aux target_at_least dm-raid 1 1 0 ; then
+	lvcreate --type raid1 -m 1 -l 2 -n raid $vg "$dev1" "$dev2"
+fi
+
+# Edits of LVs sharing segments and back references
+lvextend -l +1 $vg/linear
+lvrename $vg/striped $vg/striped2
+lvchange --addtag segtag $vg/mirror
+lvremove -ff $vg/snap
+lvchange -an $vg
+
+vgck $vg
+
+# LVs with a segment on a missing PV are marked partial in the copy too
+lvcreate -an -Zn -l 1 -n onmissing $vg "$dev5"
+aux disable_dev "$dev5"
+vgreduce --removemissing --force $vg
+aux enable_dev "$dev5"
+
+not check lv_exists $vg onmissing
+check lv_exists $vg linear striped2 mirror
+vgck $vg
+
+vgremove -ff $vg
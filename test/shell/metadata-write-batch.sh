@@ -0,0 +1,78 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+# Metadata is written to all areas at once; check failures and wrapping
+
+. lib/test
+
+# 64bit field of the mda header at offset $2 of device $1
+mda_field() {
+	od -An -tu8 -j $(( $2 + $3 )) -N8 "$1" | tr -d ' '
+}
+
+mda_offsets() {
+	pvck -v "$1" 2>&1 | \
+		sed -n 's/.*Found text metadata area: offset=\([0-9]*\),.*/\1/p'
+}
+
+# Header size, first raw location offset and size
+mda_size() { mda_field "$1" $2 32; }
+rlocn_offset() { mda_field "$1" $2 40; }
+rlocn_size() { mda_field "$1" $2 48; }
+
+no_inconsistency() {
+	vgs $vg 2>&1 | tee vgs.out
+	not grep "Inconsistent metadata" vgs.out
+}
+
+aux prepare_devs 3
+
+pvcreate --metadatacopies 2 --metadatasize 256k "$dev1"
+pvcreate --metadatasize 256k "$dev2" "$dev3"
+vgcreate -s 64k $vg "$dev1" "$dev2" "$dev3"
+lvcreate -an -Zn -l1 -n first $vg
+
+echo Check a failed write to one area is reverted on all of them
+seqno=$(get vg_field $vg vg_seqno)
+off=$(mda_offsets "$dev2" | head -1)
+# The next copy goes right after the current one
+next=$(( (off + $(rlocn_offset "$dev2" $off) + $(rlocn_size "$dev2" $off) + 511) / 512 ))
+aux error_dev "$dev2" $next:64
+not lvcreate -an -Zn -l1 -n failed $vg
+aux enable_dev "$dev2"
+
+check vg_field $vg vg_seqno $seqno
+not check lv_exists $vg failed
+no_inconsistency
+vgck $vg
+
+echo Check copies stay consistent while they wrap around the areas
+for i in $(seq 1 100); do
+	lvcreate -an -Zn -l1 -n lv$i $vg
+	test $(( $(rlocn_offset "$dev2" $off) + $(rlocn_size "$dev2" $off) )) \
+		-gt $(mda_size "$dev2" $off) && break
+done
+test $i -lt 100
+
+for dev in "$dev1" "$dev2" "$dev3"; do
+	check pv_field "$dev" vg_name $vg
+done
+check vg_field $vg lv_count $(( i + 1 ))
+check vg_field $vg vg_mda_used_count 4
+no_inconsistency
+vgck $vg
+
+# One more write starts again from the beginning of the areas
+lvcreate -an -Zn -l1 -n last $vg
+check vg_field $vg lv_count $(( i + 2 ))
+no_inconsistency
+
+vgremove -ff $vg
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+# Lookups on a VG with a missing PV rebuild the name and uuid indexes.
+# The VG read from lvmcache must not change under its locked pool
+# (detect_internal_vg_cache_corruption is set by the test suite).
+
+. lib/test
+
+aux prepare_vg 3
+
+lvcreate -an -Zn -l 1 -n $lv1 $vg "$dev1"
+lvcreate -an -Zn -l 1 -n $lv2 $vg "$dev2"
+lvcreate -an -Zn -l 2 -n $lv3 $vg "$dev1" "$dev3"
+
+aux disable_dev "$dev1"
+
+pvs 2>&1 | tee cmd.out
+not grep "Internal error" cmd.out
+pvs -a -o+vg_name 2>&1 | tee cmd.out
+not grep "Internal error" cmd.out
+lvs -a -o+devices $vg 2>&1 | tee cmd.out
+not grep "Internal error" cmd.out
+check lv_field $vg/$lv2 lv_name $lv2
+vgs -o+pv_name $vg 2>&1 | tee cmd.out
+not grep "Internal error" cmd.out
+
+aux enable_dev "$dev1"
+
+lvs $vg
+check lv_field $vg/$lv3 lv_name $lv3
+
+vgremove -ff $vg
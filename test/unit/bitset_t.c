@@ -125,9 +125,63 @@ static void test_and(void)
                 CU_ASSERT(!dm_bit(bs3, i));
 }
 
+static void test_get_next_zero(void)
+{
+        int i, j, last = -1;
+        dm_bitset_t bs = dm_bitset_create(mem, NR_BITS);
+
+        dm_bit_set_all(bs);
+        CU_ASSERT(dm_bit_get_first_zero(bs) == -1);
+
+        for (i = 0, j = 1; i < NR_BITS; i += j, j++)
+                dm_bit_clear(bs, i);
+
+        for (i = 0, j = 1; i < NR_BITS; i += j, j++) {
+                last = dm_bit_get_next_zero(bs, last);
+                CU_ASSERT(last == i);
+        }
+
+        CU_ASSERT(dm_bit_get_next_zero(bs, last) == -1);
+}
+
+static void test_count(void)
+{
+        int i, j, n = 0;
+        dm_bitset_t bs = dm_bitset_create(mem, NR_BITS);
+
+        CU_ASSERT(dm_bit_count(bs) == 0);
+
+        for (i = 0, j = 1; i < NR_BITS; i += j, j++, n++)
+                dm_bit_set(bs, i);
+
+        CU_ASSERT(dm_bit_count(bs) == (unsigned) n);
+
+        /* padding beyond NR_BITS must not be counted */
+        dm_bit_set_all(bs);
+        CU_ASSERT(dm_bit_count(bs) == NR_BITS);
+}
+
+static void test_range_set(void)
+{
+        int i, first, last;
+        dm_bitset_t bs = dm_bitset_create(mem, NR_BITS);
+
+        for (first = 0; first < NR_BITS; first += 7)
+                for (last = first; last < NR_BITS; last += 11) {
+                        dm_bit_clear_all(bs);
+                        dm_bit_range_set(bs, first, last);
+                        for (i = 0; i < NR_BITS; i++)
+                                CU_ASSERT(!dm_bit(bs, i) == (i < first || i > last));
+                        CU_ASSERT(dm_bit_count(bs) == (unsigned) (last - first + 1));
+                }
+}
+
 CU_TestInfo bitset_list[] = {
 	{ (char*)"get_next", test_get_next },
 	{ (char*)"equal", test_equal },
 	{ (char*)"and", test_and },
+	{ (char*)"get_next_zero", test_get_next_zero },
+	{ (char*)"count", test_count },
+	{ (char*)"range_set", test_range_set },
 	CU_TEST_INFO_NULL
 };
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "libdevmapper.h"
+#include "crc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+int crc_init(void);
+int crc_fini(void);
+
+#define BUF_SIZE (1024 * 1024 + 64)
+
+static uint8_t *buf = NULL;
+
+int crc_init(void)
+{
+	uint32_t i, r = 1;
+
+	if (!(buf = dm_malloc(BUF_SIZE)))
+		return 1;
+
+	for (i = 0; i < BUF_SIZE; i++) {
+		r = r * 1103515245 + 12345;
+		buf[i] = (uint8_t) (r >> 16);
+	}
+
+	return 0;
+}
+
+int crc_fini(void)
+{
+	dm_free(buf);
+
+	return 0;
+}
+
+/* Bit at a time reference */
+static uint32_t _crc_bitwise(uint32_t crc, const uint8_t *p, uint32_t size)
+{
+	unsigned i;
+
+	while (size--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return crc;
+}
+
+static void test_crc_small(void)
+{
+	uint32_t size, offset;
+
+	for (offset = 0; offset < 16; offset++)
+		for (size = 0; size <= 1024; size++)
+			CU_ASSERT_EQUAL(calc_crc(INITIAL_CRC, buf + offset, size),
+					_crc_bitwise(INITIAL_CRC, buf + offset, size));
+}
+
+static void test_crc_large(void)
+{
+	CU_ASSERT_EQUAL(calc_crc(INITIAL_CRC, buf + 1, BUF_SIZE - 1),
+			_crc_bitwise(INITIAL_CRC, buf + 1, BUF_SIZE - 1));
+	CU_ASSERT_EQUAL(calc_crc(0, buf, BUF_SIZE),
+			_crc_bitwise(0, buf, BUF_SIZE));
+}
+
+static void test_crc_chained(void)
+{
+	uint32_t whole = calc_crc(INITIAL_CRC, buf, BUF_SIZE);
+	uint32_t split;
+
+	for (split = 0; split < BUF_SIZE; split += 65537)
+		CU_ASSERT_EQUAL(calc_crc(calc_crc(INITIAL_CRC, buf, split),
+					 buf + split, BUF_SIZE - split), whole);
+}
+
+CU_TestInfo crc_list[] = {
+	{ (char*)"small", test_crc_small },
+	{ (char*)"large", test_crc_large },
+	{ (char*)"chained", test_crc_chained },
+	CU_TEST_INFO_NULL
+};
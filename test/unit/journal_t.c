@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "lib.h"
+#include "format-text.h"
+#include "layout.h"
+#include "crc.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+int journal_init(void);
+int journal_fini(void);
+
+#define TEXT_LVS 200
+
+static char *_old, *_new, *_newer;
+static uint32_t _old_size, _new_size, _newer_size;
+static char _last_error[256];
+
+/* journal.c logs through lvm; keep the last error to check the reason */
+void print_log(int level, const char *file __attribute__((unused)),
+	       int line __attribute__((unused)),
+	       int dm_errno_or_class __attribute__((unused)),
+	       const char *format, ...)
+{
+	va_list ap;
+
+	if ((level & ~(_LOG_STDERR | _LOG_ONCE)) != _LOG_ERR)
+		return;
+
+	va_start(ap, format);
+	vsnprintf(_last_error, sizeof(_last_error), format, ap);
+	va_end(ap);
+}
+
+/* Metadata-like text with one LV per section, including the NUL */
+static char *_make_text(uint32_t seqno, unsigned skip, const char *extra,
+			uint32_t *size)
+{
+	char *text, *p;
+	unsigned i;
+
+	if (!(text = dm_malloc(TEXT_LVS * 128 + 256)))
+		return NULL;
+
+	p = text + sprintf(text, "vg {\n\tid = \"abcdef\"\n\tseqno = %u\n", seqno);
+
+	for (i = 0; i < TEXT_LVS; i++) {
+		if (i == skip)
+			continue;
+		p += sprintf(p, "\tlvol%u {\n\t\tid = \"%08u-lv\"\n"
+			     "\t\tsegment_count = 1\n\t\tstart_extent = %u\n\t}\n",
+			     i, i * 7919, i * 16);
+	}
+
+	p += sprintf(p, "%s}\n", extra);
+	*size = (uint32_t) (p - text) + 1;
+
+	return text;
+}
+
+int journal_init(void)
+{
+	if (!(_old = _make_text(1, TEXT_LVS, "", &_old_size)) ||
+	    !(_new = _make_text(2, 17, "\ttags = [\"new\"]\n", &_new_size)) ||
+	    !(_newer = _make_text(3, 17, "\ttags = [\"new\", \"newer\"]\n", &_newer_size)))
+		return 1;
+
+	return 0;
+}
+
+int journal_fini(void)
+{
+	dm_free(_old);
+	dm_free(_new);
+	dm_free(_newer);
+
+	return 0;
+}
+
+static uint32_t _crc(const char *text, uint32_t size)
+{
+	return calc_crc(INITIAL_CRC, (const uint8_t *) text, size);
+}
+
+/* Base copy followed by a record turning it into new */
+static char *_make_span(const char *new, uint32_t new_size, uint32_t *size)
+{
+	char *record = NULL, *span;
+	uint32_t len;
+
+	if (!(len = journal_delta(_old, _old_size, new, new_size,
+				  _crc(new, new_size), UINT32_MAX, &record)))
+		return NULL;
+
+	if ((span = dm_malloc(_old_size + len))) {
+		memcpy(span, _old, _old_size);
+		memcpy(span + _old_size, record, len);
+		*size = _old_size + len;
+	}
+
+	dm_free(record);
+
+	return span;
+}
+
+static void test_round_trip(void)
+{
+	char *record = NULL, *span;
+	uint32_t len, size, text_crc = 0, base_size, records;
+
+	/* Small changes produce records much smaller than the text */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = _make_span(_new, _new_size, &size));
+	CU_ASSERT(size - _old_size < _new_size / 8);
+
+	CU_ASSERT_FATAL(journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT_EQUAL(records, 1);
+	CU_ASSERT_EQUAL(base_size, _old_size);
+	CU_ASSERT_EQUAL(text_crc, _crc(_new, _new_size));
+	CU_ASSERT_EQUAL(size, _new_size);
+	CU_ASSERT(!memcmp(span, _new, _new_size));
+	dm_free(span);
+
+	/* A second record applies on top of the first */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = _make_span(_new, _new_size, &size));
+	CU_ASSERT_FATAL(len = journal_delta(_new, _new_size, _newer, _newer_size,
+					    _crc(_newer, _newer_size), UINT32_MAX,
+					    &record));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = dm_realloc(span, size + len));
+	memcpy(span + size, record, len);
+	size += len;
+	dm_free(record);
+
+	CU_ASSERT_FATAL(journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT_EQUAL(records, 2);
+	CU_ASSERT_EQUAL(base_size, _old_size);
+	CU_ASSERT_EQUAL(size, _newer_size);
+	CU_ASSERT(!memcmp(span, _newer, _newer_size));
+	dm_free(span);
+
+	/* A record above the limit is not built */
+	CU_ASSERT_EQUAL(journal_delta(_old, _old_size, _new, _new_size,
+				      _crc(_new, _new_size), 64, &record), 0);
+
+	/* Without records the base copy is the text */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = dm_malloc(_old_size));
+	memcpy(span, _old, _old_size);
+	size = _old_size;
+	CU_ASSERT_FATAL(journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT_EQUAL(records, 0);
+	CU_ASSERT_EQUAL(size, _old_size);
+	dm_free(span);
+}
+
+/* The span crosses the end of the circular metadata area */
+static void test_wrapped(void)
+{
+	char *span, *ring, *buf;
+	uint32_t size, ring_size, offset, wrap, text_crc, base_size, records;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = _make_span(_new, _new_size, &size));
+
+	/* Split it inside the record, as the area reader sees it */
+	ring_size = size + 4096;
+	offset = ring_size - (_old_size + 10);
+	wrap = offset + size - ring_size;
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ring = dm_zalloc(ring_size));
+	memcpy(ring + offset, span, size - wrap);
+	memcpy(ring, span + size - wrap, wrap);
+	dm_free(span);
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf = dm_malloc(size));
+	memcpy(buf, ring + offset, size - wrap);
+	memcpy(buf + size - wrap, ring, wrap);
+	dm_free(ring);
+
+	CU_ASSERT_FATAL(journal_replay(&buf, &size, &text_crc, &base_size, &records));
+	CU_ASSERT_EQUAL(records, 1);
+	CU_ASSERT_EQUAL(size, _new_size);
+	CU_ASSERT(!memcmp(buf, _new, _new_size));
+	dm_free(buf);
+}
+
+static void test_truncated(void)
+{
+	char *span;
+	uint32_t size, full, text_crc, base_size, records;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = _make_span(_new, _new_size, &full));
+
+	/* Cut inside the record header */
+	size = _old_size + sizeof(struct journal_record) - 1;
+	_last_error[0] = '\0';
+	CU_ASSERT(!journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT(strstr(_last_error, "Truncated metadata journal record 1") != NULL);
+
+	/* Cut inside the operations */
+	size = full - 1;
+	_last_error[0] = '\0';
+	CU_ASSERT(!journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT(strstr(_last_error, "Invalid metadata journal record 1") != NULL);
+
+	/* Base copy without its terminating NUL */
+	size = _old_size - 1;
+	_last_error[0] = '\0';
+	CU_ASSERT(!journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT(strstr(_last_error, "not terminated") != NULL);
+
+	/* The caller's buffer is left alone on failure */
+	CU_ASSERT(!memcmp(span, _old, _old_size));
+	dm_free(span);
+}
+
+static void test_crc_mismatch(void)
+{
+	struct journal_record rec;
+	char *span;
+	uint32_t size, text_crc, base_size, records;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(span = _make_span(_new, _new_size, &size));
+
+	memcpy(&rec, span + _old_size, sizeof(rec));
+	rec.text_crc_xl ^= 1;
+	memcpy(span + _old_size, &rec, sizeof(rec));
+
+	_last_error[0] = '\0';
+	CU_ASSERT(!journal_replay(&span, &size, &text_crc, &base_size, &records));
+	CU_ASSERT(strstr(_last_error, "checksum error") != NULL);
+	dm_free(span);
+}
+
+CU_TestInfo journal_list[] = {
+	{ (char*)"round_trip", test_round_trip },
+	{ (char*)"wrapped", test_wrapped },
+	{ (char*)"truncated", test_truncated },
+	{ (char*)"crc_mismatch", test_crc_mismatch },
+	CU_TEST_INFO_NULL
+};
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "libdevmapper.h"
+
+#include <CUnit/CUnit.h>
+
+int pool_init(void);
+int pool_fini(void);
+
+int pool_init(void)
+{
+	return 0;
+}
+
+int pool_fini(void)
+{
+	dm_pool_set_thread_cache(0);
+
+	return 0;
+}
+
+static void test_stats(void)
+{
+	struct dm_pool_stats stats;
+	struct dm_pool *mem = dm_pool_create("pool stats test", 1024);
+	int i;
+
+	CU_ASSERT_PTR_NOT_NULL(mem);
+
+	dm_pool_get_stats(mem, &stats);
+	CU_ASSERT_EQUAL(stats.chunks, 0);
+	CU_ASSERT_EQUAL(stats.bytes, 0);
+
+	for (i = 0; i < 64; i++)
+		CU_ASSERT_PTR_NOT_NULL(dm_pool_alloc(mem, 100));
+
+	dm_pool_get_stats(mem, &stats);
+	CU_ASSERT(stats.chunks > 1);
+	CU_ASSERT(stats.used_bytes >= 64 * 100);
+	CU_ASSERT(stats.bytes >= stats.used_bytes);
+	CU_ASSERT_EQUAL(stats.peak_bytes, stats.bytes);
+
+	dm_pool_empty(mem);
+	dm_pool_get_stats(mem, &stats);
+	CU_ASSERT(stats.used_bytes < 100);
+	CU_ASSERT(stats.peak_bytes >= stats.bytes);
+
+	dm_pool_destroy(mem);
+}
+
+static void test_thread_cache(void)
+{
+	struct dm_pool *mem;
+	void *first, *second;
+
+	dm_pool_set_thread_cache(4);
+
+	mem = dm_pool_create("pool cache test", 1024);
+	CU_ASSERT_PTR_NOT_NULL(first = dm_pool_alloc(mem, 100));
+	dm_pool_destroy(mem);
+
+	/* The released chunk is reused by the next pool in this thread */
+	mem = dm_pool_create("pool cache test", 1024);
+	CU_ASSERT_PTR_NOT_NULL(second = dm_pool_alloc(mem, 100));
+	CU_ASSERT(first == second);
+	dm_pool_destroy(mem);
+
+	dm_pool_set_thread_cache(0);
+}
+
+CU_TestInfo pool_list[] = {
+	{ (char*)"stats", test_stats },
+	{ (char*)"thread_cache", test_thread_cache },
+	CU_TEST_INFO_NULL
+};
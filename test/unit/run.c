@@ -11,12 +11,18 @@ DECL(bitset);
 DECL(regex);
 DECL(config);
 DECL(string);
+DECL(pool);
+DECL(crc);
+DECL(journal);
 
 CU_SuiteInfo suites[] = {
 	USE(bitset),
 	USE(regex),
 	USE(config),
 	USE(string),
+	USE(pool),
+	USE(crc),
+	USE(journal),
 	CU_SUITE_INFO_NULL
 };
 
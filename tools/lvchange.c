@@ -1151,6 +1151,7 @@ int lvchange(struct cmd_context *cmd, int argc, char **argv)
 		arg_count(cmd, writemostly_ARG) ||
 		arg_count(cmd, zero_ARG);
 	int update = update_partial_safe || update_partial_unsafe;
+	int r;
 
 	if (!update &&
             !arg_count(cmd, activate_ARG) && !arg_count(cmd, refresh_ARG) &&
@@ -1213,7 +1214,12 @@ int lvchange(struct cmd_context *cmd, int argc, char **argv)
 		return ECMD_PROCESSED;
 	}
 
-	return process_each_lv(cmd, argc, argv,
-			       update ? READ_FOR_UPDATE : 0, NULL,
-			       &lvchange_single);
+	r = process_each_lv(cmd, argc, argv,
+			    update ? READ_FOR_UPDATE : 0, NULL,
+			    &lvchange_single);
+
+	if (arg_count(cmd, activate_ARG))
+		fs_log_udev_waits();
+
+	return r;
 }
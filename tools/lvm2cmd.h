@@ -76,6 +76,14 @@ void lvm2_log_level(void *handle, int level);
  */
 int lvm2_run(void *handle, const char *cmdline);
 
+/*
+ * Equivalent of 'lvextend --use-policies vg_name/lv_name' that skips
+ * command line processing, for callers keeping a long-lived handle.
+ * Returns the same values as lvm2_run.
+ */
+int lvm2_extend_by_policy(void *handle, const char *vg_name,
+			  const char *lv_name);
+
 /* Release handle */
 void lvm2_exit(void *handle);
 
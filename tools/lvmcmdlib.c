@@ -94,6 +94,76 @@ int lvm2_run(void *handle, const char *cmdline)
 	return ret;
 }
 
+int lvm2_extend_by_policy(void *handle, const char *vg_name,
+			  const char *lv_name)
+{
+	struct cmd_context *cmd = (struct cmd_context *) handle;
+	struct lvresize_params lp = {
+		.vg_name = vg_name,
+		.lv_name = lv_name,
+		.sign = SIGN_PLUS,
+		.poolmetadatasign = SIGN_NONE,
+		.percent = PERCENT_LV,
+		.resize = LV_EXTEND,
+		.ac_policy = 1,
+	};
+	size_t len = strlen(vg_name) + strlen(lv_name) +
+		sizeof("lvextend --use-policies /");
+	char *cmd_line;
+	int ret = ECMD_FAILED;
+
+	init_error_message_produced(0);
+	sigint_clear();
+
+	/* Recorded in the archive description like the equivalent command */
+	if (!(cmd_line = dm_pool_alloc(cmd->mem, len)) ||
+	    dm_snprintf(cmd_line, len, "lvextend --use-policies %s/%s",
+			vg_name, lv_name) < 0)
+		goto_out;
+	cmd->cmd_line = cmd_line;
+
+	set_cmd_name("lvextend");
+	log_debug("Processing: %s", cmd->cmd_line);
+
+	if ((!cmd->config_initialized || config_files_changed(cmd)) &&
+	    !refresh_toolcontext(cmd)) {
+		log_error("Updated config file invalid. Aborting.");
+		goto out;
+	}
+
+	if (cmd->metadata_read_only) {
+		log_error("%s: Command not permitted while global/metadata_read_only "
+			  "is set.", cmd->cmd_line);
+		goto out;
+	}
+
+	if (!validate_name(vg_name)) {
+		log_error("Volume group name %s has invalid characters",
+			  vg_name);
+		ret = EINVALID_CMD_LINE;
+		goto out;
+	}
+
+	init_dmeventd_monitor(find_config_tree_bool(cmd, activation_monitoring_CFG, NULL) ?
+			      DEFAULT_DMEVENTD_MONITOR : DMEVENTD_MONITOR_IGNORE);
+
+	if (!init_locking(-1, cmd, 0))
+		goto_out;
+
+	ret = lvresize_by_params(cmd, &lp);
+
+	fin_locking();
+
+	log_debug("Completed: %s", cmd->cmd_line);
+out:
+	dm_pool_empty(cmd->mem);
+
+	reset_lvm_errno(1);
+	reset_log_duplicated();
+
+	return ret;
+}
+
 void lvm2_disable_dmeventd_monitoring(void *handle) {
 	init_dmeventd_monitor(DMEVENTD_MONITOR_IGNORE);
 }
@@ -164,47 +164,53 @@ static int _lvresize_params(struct cmd_context *cmd, int argc, char **argv,
 	return 1;
 }
 
-int lvresize(struct cmd_context *cmd, int argc, char **argv)
+int lvresize_by_params(struct cmd_context *cmd, struct lvresize_params *lp)
 {
-	struct lvresize_params lp = { 0 };
 	struct volume_group *vg;
 	struct dm_list *pvh = NULL;
 	struct lv_list *lvl;
 	int r = ECMD_FAILED;
 
-	if (!_lvresize_params(cmd, argc, argv, &lp))
-		return EINVALID_CMD_LINE;
-
-	log_verbose("Finding volume group %s", lp.vg_name);
-	vg = vg_read_for_update(cmd, lp.vg_name, NULL, 0);
+	log_verbose("Finding volume group %s", lp->vg_name);
+	vg = vg_read_for_update(cmd, lp->vg_name, NULL, 0);
 	if (vg_read_error(vg)) {
 		release_vg(vg);
 		return_ECMD_FAILED;
 	}
 
         /* Does LV exist? */
-        if (!(lvl = find_lv_in_vg(vg, lp.lv_name))) {
+        if (!(lvl = find_lv_in_vg(vg, lp->lv_name))) {
                 log_error("Logical volume %s not found in volume group %s",
-                          lp.lv_name, lp.vg_name);
+                          lp->lv_name, lp->vg_name);
 		goto out;
         }
 
-	if (!(pvh = lp.argc ? create_pv_list(cmd->mem, vg, lp.argc,
-					     lp.argv, 1) : &vg->pvs))
+	if (!(pvh = lp->argc ? create_pv_list(cmd->mem, vg, lp->argc,
+					      lp->argv, 1) : &vg->pvs))
 		goto_out;
 
-	if (!lv_resize_prepare(cmd, lvl->lv, &lp, pvh)) {
+	if (!lv_resize_prepare(cmd, lvl->lv, lp, pvh)) {
 		r = EINVALID_CMD_LINE;
 		goto_out;
 	}
 
-	if (!lv_resize(cmd, lvl->lv, &lp, pvh))
+	if (!lv_resize(cmd, lvl->lv, lp, pvh))
 		goto_out;
 
 	r = ECMD_PROCESSED;
 
 out:
-	unlock_and_release_vg(cmd, vg, lp.vg_name);
+	unlock_and_release_vg(cmd, vg, lp->vg_name);
 
 	return r;
 }
+
+int lvresize(struct cmd_context *cmd, int argc, char **argv)
+{
+	struct lvresize_params lp = { 0 };
+
+	if (!_lvresize_params(cmd, argc, argv, &lp))
+		return EINVALID_CMD_LINE;
+
+	return lvresize_by_params(cmd, &lp);
+}
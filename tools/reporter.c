@@ -349,6 +349,9 @@ static int _report(struct cmd_context *cmd, int argc, char **argv,
 	else if (report_type & LVS)
 		report_type = LVS;
 
+	/* Query kernel state of all devices at once, not per field */
+	activation_use_snapshot(1);
+
 	switch (report_type) {
 	case LVS:
 		r = process_each_lv(cmd, argc, argv, 0, report_handle,
@@ -384,6 +387,8 @@ static int _report(struct cmd_context *cmd, int argc, char **argv,
 		break;
 	}
 
+	activation_use_snapshot(0);
+
 	dm_report_output(report_handle);
 
 	dm_report_free(report_handle);
@@ -128,4 +128,7 @@ int get_stripe_params(struct cmd_context *cmd, uint32_t *stripes,
 int change_tag(struct cmd_context *cmd, struct volume_group *vg,
 	       struct logical_volume *lv, struct physical_volume *pv, int arg);
 
+/* Resize lp->lv_name as lvresize would once its arguments are parsed */
+int lvresize_by_params(struct cmd_context *cmd, struct lvresize_params *lp);
+
 #endif
@@ -81,12 +81,65 @@ static int _poll_lvs_in_vg(struct cmd_context *cmd,
 	return count;
 }
 
+/*
+ * (De)activate the collected LVs through one dm tree when LV locks
+ * only mean local activation.  Activation falls back to one LV at
+ * a time otherwise, or if the combined activation does not succeed.
+ */
+static int _activate_lv_list(struct cmd_context *cmd, struct volume_group *vg,
+			     struct dm_list *lvs, activation_change_t activate)
+{
+	struct lv_list *lvl;
+	int count = 0;
+	int together = dm_list_size(lvs) > 1 &&
+		!vg_is_clustered(vg) && locking_activates_locally();
+
+	if (together && activate == CHANGE_AN) {
+		log_verbose("Deactivating %d logical volumes in volume group \"%s\"",
+			    dm_list_size(lvs), vg->name);
+		if (!deactivate_lvs_local(cmd, lvs))
+			stack;
+		/* Count what went away */
+		dm_list_iterate_items(lvl, lvs)
+			if (!lv_is_active(lvl->lv))
+				count++;
+		return count;
+	}
+
+	if (together && activate != CHANGE_ALN &&
+	    activate_lvs_local(cmd, lvs)) {
+		dm_list_iterate_items(lvl, lvs)
+			if (background_polling() &&
+			    (lvl->lv->status & (PVMOVE|CONVERTING|MERGING)))
+				lv_spawn_background_polling(cmd, lvl->lv);
+		return dm_list_size(lvs);
+	}
+
+	dm_list_iterate_items(lvl, lvs) {
+		if (sigint_caught())
+			break;
+
+		if (!lv_change_activate(cmd, lvl->lv, activate)) {
+			stack;
+			continue;
+		}
+
+		count++;
+	}
+
+	return count;
+}
+
 static int _activate_lvs_in_vg(struct cmd_context *cmd, struct volume_group *vg,
 			       activation_change_t activate)
 {
-	struct lv_list *lvl;
+	struct lv_list *lvl, *lvl_new;
 	struct logical_volume *lv;
+	struct dm_list activate_lvs;
 	int count = 0, expected_count = 0;
+	int collect = (activate != CHANGE_ALN);
+
+	dm_list_init(&activate_lvs);
 
 	sigint_allow();
 	dm_list_iterate_items(lvl, &vg->lvs) {
@@ -143,6 +196,18 @@ static int _activate_lvs_in_vg(struct cmd_context *cmd, struct volume_group *vg,
 
 		expected_count++;
 
+		/* Changes are collected and done together below */
+		if (collect) {
+			if (!(lvl_new = dm_pool_alloc(cmd->mem, sizeof(*lvl_new)))) {
+				log_error("Failed to allocate LV list item.");
+				sigint_restore();
+				return 0;
+			}
+			lvl_new->lv = lv;
+			dm_list_add(&activate_lvs, &lvl_new->list);
+			continue;
+		}
+
 		if (!lv_change_activate(cmd, lv, activate)) {
 			stack;
 			continue;
@@ -151,6 +216,9 @@ static int _activate_lvs_in_vg(struct cmd_context *cmd, struct volume_group *vg,
 		count++;
 	}
 
+	if (!dm_list_empty(&activate_lvs))
+		count = _activate_lv_list(cmd, vg, &activate_lvs, activate);
+
 	sigint_restore();
 
 	if (expected_count)
@@ -555,6 +623,7 @@ int vgchange(struct cmd_context *cmd, int argc, char **argv)
 		arg_count(cmd, alloc_ARG) ||
 		arg_count(cmd, vgmetadatacopies_ARG);
 	int update = update_partial_safe || update_partial_unsafe;
+	int r;
 
 	if (!update &&
 	    !arg_count(cmd, activate_ARG) &&
@@ -626,6 +695,11 @@ int vgchange(struct cmd_context *cmd, int argc, char **argv)
 	if (!update || !update_partial_unsafe)
 		cmd->handles_missing_pvs = 1;
 
-	return process_each_vg(cmd, argc, argv, update ? READ_FOR_UPDATE : 0,
-			       NULL, &vgchange_single);
+	r = process_each_vg(cmd, argc, argv, update ? READ_FOR_UPDATE : 0,
+			    NULL, &vgchange_single);
+
+	if (arg_count(cmd, activate_ARG))
+		fs_log_udev_waits();
+
+	return r;
 }